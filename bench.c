@@ -0,0 +1,568 @@
+#define _GNU_SOURCE
+
+#include <math.h>
+#include <search.h>
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_CYCLES() __rdtsc()
+#else
+#define BENCH_CYCLES() 0
+#endif
+
+#ifndef RHMAPPER_COMPACT
+#include "rhmapper_sharded.h"
+#endif
+#include "rhmapper_frozen.h"
+#include "rhmapper_snapshot.h"
+#include "rhmapper_stream.h"
+#include "rhmapper_u64.h"
+
+#if defined(RHMAPPER_COMPACT)
+#define BENCH_MODE "compact"
+#elif defined(RHMAPPER_INCREMENTAL)
+#define BENCH_MODE "incr"
+#elif defined(RHMAPPER_MODULO)
+#define BENCH_MODE "modulo"
+#else
+#define BENCH_MODE "pow2"
+#endif
+
+typedef struct bench_keys bench_keys_t;
+typedef struct bench_worker bench_worker_t;
+typedef struct bench_timer bench_timer_t;
+
+struct bench_keys {
+  size_t count;
+  size_t *sizes;
+  char **data;
+};
+
+#ifndef RHMAPPER_COMPACT
+struct bench_worker {
+  rhmapper_sharded_t *sh;
+  bench_keys_t *keys;
+  size_t from;
+  size_t to;
+};
+#endif
+
+struct bench_timer {
+  double ns;
+  uint64_t cycles;
+};
+
+uint64_t bench_state = 0x9E3779B97F4A7C15;
+int bench_perf = -1;
+
+uint64_t bench_random(void) {
+  bench_state ^= bench_state << 13;
+  bench_state ^= bench_state >> 7;
+  bench_state ^= bench_state << 17;
+  return bench_state;
+}
+
+double bench_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+bench_keys_t bench_keys_create(size_t count, size_t min, size_t max) {
+  bench_keys_t keys = {
+      .count = count,
+      .sizes = rhmapper_calloc(count, sizeof(size_t)),
+      .data = rhmapper_calloc(count, sizeof(char *)),
+  };
+  for (size_t i = 0; i < count; i++) {
+    size_t size = min + bench_random() % (max - min + 1);
+    char *data = rhmapper_malloc(size + 1);
+    for (size_t j = 0; j < size; j++) {
+      data[j] = 'a' + bench_random() % 26;
+    }
+    data[size] = '\0';
+    keys.sizes[i] = size;
+    keys.data[i] = data;
+  }
+  return keys;
+}
+
+void bench_keys_destroy(bench_keys_t keys) {
+  for (size_t i = 0; i < keys.count; i++) {
+    free(keys.data[i]);
+  }
+  free(keys.sizes);
+  free(keys.data);
+}
+
+void bench_report(const char *name, size_t n, double start, size_t check) {
+  double ns = (bench_now() - start) / n;
+  printf("%-8s %-9s %10zu ops %8.2f ns/op (%zu)\n", BENCH_MODE, name, n, ns,
+         check);
+}
+
+size_t *bench_uniform(size_t n, size_t count) {
+  size_t *indices = rhmapper_malloc(count * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    indices[i] = bench_random() % n;
+  }
+  return indices;
+}
+
+size_t *bench_zipf(size_t n, size_t count, double s) {
+  double *cdf = rhmapper_malloc(n * sizeof(double));
+  double sum = 0;
+  for (size_t i = 0; i < n; i++) {
+    sum += 1 / pow(i + 1, s);
+    cdf[i] = sum;
+  }
+  size_t *indices = rhmapper_malloc(count * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    double u = (bench_random() >> 11) * 0x1p-53 * sum;
+    size_t low = 0;
+    size_t high = n - 1;
+    while (low < high) {
+      size_t mid = low + (high - low) / 2;
+      if (cdf[mid] < u) {
+        low = mid + 1;
+      } else {
+        high = mid;
+      }
+    }
+    indices[i] = low;
+  }
+  free(cdf);
+  return indices;
+}
+
+void bench_perf_open(void) {
+#ifdef __linux__
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.size = sizeof(attr);
+  attr.config = PERF_COUNT_HW_CACHE_MISSES;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  bench_perf = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+}
+
+bench_timer_t bench_begin(void) {
+#ifdef __linux__
+  if (bench_perf >= 0) {
+    ioctl(bench_perf, PERF_EVENT_IOC_RESET, 0);
+    ioctl(bench_perf, PERF_EVENT_IOC_ENABLE, 0);
+  }
+#endif
+  bench_timer_t timer = {
+      .ns = bench_now(),
+      .cycles = BENCH_CYCLES(),
+  };
+  return timer;
+}
+
+void bench_end(const char *name, const char *config, size_t n,
+               bench_timer_t timer, size_t check) {
+  double ns = (bench_now() - timer.ns) / n;
+  double cycles = (double)(BENCH_CYCLES() - timer.cycles) / n;
+  double misses = -1;
+#ifdef __linux__
+  long long count;
+  if (bench_perf >= 0) {
+    ioctl(bench_perf, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(bench_perf, &count, sizeof(count)) == sizeof(count)) {
+      misses = (double)count / n;
+    }
+  }
+#endif
+  printf("%-8s %-9s %-24s %8.2f ns/op %8.1f cycles/op %6.2f misses/op "
+         "(%zu)\n",
+         BENCH_MODE, name, config, ns, cycles, misses, check);
+}
+
+void bench_lookups(const char *name, const char *config, rhmapper_t *rh,
+                   bench_keys_t keys, size_t *indices, size_t count) {
+#ifdef RHMAPPER_CACHE
+  rh->hits = 0;
+  rh->misses = 0;
+#endif
+  bench_timer_t timer = bench_begin();
+  size_t check = 0;
+  for (size_t i = 0; i < count; i++) {
+    size_t j = indices[i];
+    check += rhmapper_get(rh, keys.data[j], keys.sizes[j]);
+  }
+  bench_end(name, config, count, timer, check);
+#ifdef RHMAPPER_CACHE
+  printf("%-8s %-9s %-24s %8.2f%% cache hits\n", BENCH_MODE, name, config,
+         100.0 * rh->hits / (rh->hits + rh->misses));
+#endif
+}
+
+#ifdef RHMAPPER_REVERSE
+void bench_reverse(const char *name, const char *config, rhmapper_t *rh,
+                   size_t *indices, size_t count) {
+  bench_timer_t timer = bench_begin();
+  size_t check = 0;
+  for (size_t i = 0; i < count; i++) {
+    rhmapper_string_t key = rhmapper_rev(rh, indices[i] % rh->size);
+    check += key.size + key.data[0];
+  }
+  bench_end(name, config, count, timer, check);
+}
+#endif
+
+#ifdef RHMAPPER_STATS
+void bench_stats(const char *config, rhmapper_t *rh) {
+  rhmapper_stats_t stats;
+  rhmapper_stats(rh, &stats);
+  printf("%-8s %-9s %-24s psl %.2f mean %zu max, miss %.2f mean, %zu grows "
+         "%.3f s\n",
+         BENCH_MODE, "stats", config, stats.psl_mean, stats.psl_max,
+         stats.miss_mean, stats.grows, stats.grow_seconds);
+}
+#endif
+
+void bench_reference(const char *config, size_t capacity, bench_keys_t keys,
+                     bench_keys_t misses, size_t *indices, size_t count) {
+  hcreate(capacity);
+  bench_timer_t timer = bench_begin();
+  size_t check = 0;
+  for (size_t i = 0; i < keys.count; i++) {
+    ENTRY item = {
+        .key = keys.data[i],
+        .data = (void *)(uintptr_t)i,
+    };
+    check += (uintptr_t)hsearch(item, ENTER)->data;
+  }
+  bench_end("ref-put", config, keys.count, timer, check);
+
+  timer = bench_begin();
+  check = 0;
+  for (size_t i = 0; i < count; i++) {
+    ENTRY item = {.key = keys.data[indices[i]]};
+    check += (uintptr_t)hsearch(item, FIND)->data;
+  }
+  bench_end("ref-get", config, count, timer, check);
+
+  timer = bench_begin();
+  check = 0;
+  for (size_t i = 0; i < count; i++) {
+    ENTRY item = {.key = misses.data[i % misses.count]};
+    check += hsearch(item, FIND) == NULL;
+  }
+  bench_end("ref-miss", config, count, timer, check);
+  hdestroy();
+}
+
+void bench_matrix(size_t max) {
+  static const size_t lengths[][2] = {{4, 8}, {16, 32}, {64, 256}};
+  static const double loads[] = {0.25, 0.5, 0.75};
+  bench_perf_open();
+  for (size_t capacity = 1 << 10; capacity <= max; capacity <<= 4) {
+    for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+      if (capacity * lengths[l][1] > (size_t)1 << 28) {
+        continue;
+      }
+      for (size_t f = 0; f < sizeof(loads) / sizeof(loads[0]); f++) {
+        size_t n = capacity * loads[f];
+        size_t count = n < 1 << 20 ? 1 << 20 : n;
+        char config[64];
+        snprintf(config, sizeof(config), "n=%zu k=%zu-%zu lf=%.2f", n,
+                 lengths[l][0], lengths[l][1], loads[f]);
+        bench_keys_t keys = bench_keys_create(n, lengths[l][0], lengths[l][1]);
+        bench_keys_t misses =
+            bench_keys_create(n, lengths[l][0], lengths[l][1]);
+        size_t *uniform = bench_uniform(n, count);
+        size_t *zipf = bench_zipf(n, count, 0.99);
+
+        rhmapper_t *rh = rhmapper_create(capacity);
+        bench_timer_t timer = bench_begin();
+        size_t check = 0;
+        for (size_t i = 0; i < n; i++) {
+          check += rhmapper_put(rh, keys.data[i], keys.sizes[i]);
+        }
+        bench_end("put", config, n, timer, check);
+#ifdef RHMAPPER_STATS
+        bench_stats(config, rh);
+#endif
+        bench_lookups("get-unif", config, rh, keys, uniform, count);
+        bench_lookups("get-zipf", config, rh, keys, zipf, count);
+        timer = bench_begin();
+        check = 0;
+        for (size_t i = 0; i < count; i++) {
+          size_t j = i % n;
+          check += rhmapper_get(rh, misses.data[j], misses.sizes[j]) ==
+                   (size_t)RHMAPPER_EMPTY_VALUE;
+        }
+        bench_end("get-miss", config, count, timer, check);
+#ifdef RHMAPPER_REVERSE
+        bench_reverse("rev-unif", config, rh, uniform, count);
+        bench_reverse("rev-zipf", config, rh, zipf, count);
+#endif
+        rhmapper_destroy(rh);
+        bench_reference(config, capacity, keys, misses, uniform, count);
+
+        free(uniform);
+        free(zipf);
+        bench_keys_destroy(keys);
+        bench_keys_destroy(misses);
+      }
+    }
+  }
+}
+
+void bench_stream(bench_keys_t keys) {
+  FILE *file = fopen("bench.txt", "wb");
+  for (size_t i = 0; i < keys.count; i++) {
+    fwrite(keys.data[i], 1, keys.sizes[i], file);
+    fputc(i % 16 ? ' ' : '\n', file);
+  }
+  fclose(file);
+
+  rhmapper_t *rh = rhmapper_create(1);
+  int fd = open("bench.txt", O_RDONLY);
+  rhmapper_stream_t *stream = rhmapper_stream_create(rh, fd, " \n");
+  size_t *ids = rhmapper_malloc(4096 * sizeof(size_t));
+  double start = bench_now();
+  size_t n = 0;
+  size_t check = 0;
+  for (size_t count; (count = rhmapper_stream_read(stream, ids, 4096));) {
+    for (size_t i = 0; i < count; i++) {
+      check += ids[i];
+    }
+    n += count;
+  }
+  bench_report("stream", n, start, check);
+  free(ids);
+  rhmapper_stream_destroy(stream);
+  close(fd);
+  rhmapper_destroy(rh);
+  remove("bench.txt");
+}
+
+void bench_u64(size_t n) {
+  uint64_t *ids = rhmapper_malloc(n * sizeof(uint64_t));
+  for (size_t i = 0; i < n; i++) {
+    ids[i] = bench_random() % (n / 2 + 1) * 0x10001;
+  }
+  rhmapper_t *rh = rhmapper_create(1);
+  double start = bench_now();
+  size_t check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_put(rh, (char *)&ids[i], sizeof(ids[i]));
+  }
+  bench_report("id-put", n, start, check);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_get(rh, (char *)&ids[i], sizeof(ids[i]));
+  }
+  bench_report("id-get", n, start, check);
+  rhmapper_destroy(rh);
+
+  rhmapper_u64_t *u64 = rhmapper_u64_create(1);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_u64_put(u64, ids[i]);
+  }
+  bench_report("u64-put", n, start, check);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_u64_get(u64, ids[i]);
+  }
+  bench_report("u64-get", n, start, check);
+  rhmapper_u64_destroy(u64);
+  free(ids);
+}
+
+void bench_hash(const char *name, size_t (*hash)(const char *, size_t),
+                bench_keys_t keys) {
+  double start = bench_now();
+  size_t check = 0;
+  for (size_t i = 0; i < keys.count; i++) {
+    check += hash(keys.data[i], keys.sizes[i]);
+  }
+  bench_report(name, keys.count, start, check);
+}
+
+void bench_hashes(const char *name, bench_keys_t keys) {
+  printf("hash %s keys\n", name);
+  bench_hash("xxh3", rhmapper_hash_xxh3, keys);
+  bench_hash("xxh64", rhmapper_hash_xxh64, keys);
+  bench_hash("mul", rhmapper_hash_mul, keys);
+}
+
+#ifndef RHMAPPER_COMPACT
+void *bench_sharded_worker(void *arg) {
+  bench_worker_t *worker = arg;
+  for (size_t i = worker->from; i < worker->to; i++) {
+    rhmapper_sharded_put(
+        worker->sh, worker->keys->data[i], worker->keys->sizes[i]);
+  }
+  return NULL;
+}
+
+void bench_sharded(bench_keys_t keys, size_t threads) {
+  rhmapper_sharded_t *sh = rhmapper_sharded_create(64, 1);
+  pthread_t handles[64];
+  bench_worker_t workers[64];
+  double start = bench_now();
+  for (size_t i = 0; i < threads; i++) {
+    workers[i].sh = sh;
+    workers[i].keys = &keys;
+    workers[i].from = keys.count * i / threads;
+    workers[i].to = keys.count * (i + 1) / threads;
+    pthread_create(&handles[i], NULL, bench_sharded_worker, &workers[i]);
+  }
+  for (size_t i = 0; i < threads; i++) {
+    pthread_join(handles[i], NULL);
+  }
+  char name[16];
+  snprintf(name, sizeof(name), "sharded%zu", threads);
+  bench_report(name, keys.count, start, atomic_load(&sh->size));
+  rhmapper_sharded_destroy(sh);
+}
+#endif
+
+int main(int argc, char **argv) {
+  if (argc > 1 && !strcmp(argv[1], "matrix")) {
+    bench_matrix(argc > 2 ? strtoull(argv[2], NULL, 10) : 1 << 22);
+    return 0;
+  }
+  size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1 << 22;
+  bench_keys_t keys = bench_keys_create(n, 4, 32);
+  bench_keys_t misses = bench_keys_create(n, 4, 32);
+
+  rhmapper_t *rh = rhmapper_create(1);
+  double start = bench_now();
+  size_t check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_put(rh, keys.data[i], keys.sizes[i]);
+  }
+  bench_report("put", n, start, check);
+
+  start = bench_now();
+  rhmapper_t *built = rhmapper_build(keys.data, keys.sizes, n);
+  bench_report("build", n, start, built->size);
+  rhmapper_destroy(built);
+
+  rhmapper_t *latency = rhmapper_create(1);
+  double worst = 0;
+  for (size_t i = 0; i < n; i++) {
+    start = bench_now();
+    rhmapper_put(latency, keys.data[i], keys.sizes[i]);
+    double ns = bench_now() - start;
+    worst = ns > worst ? ns : worst;
+  }
+  printf("%-8s %-9s %10zu ops %8.0f ns worst\n", BENCH_MODE, "put-max", n,
+         worst);
+  rhmapper_destroy(latency);
+
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t j = bench_random() % n;
+    check += rhmapper_get(rh, keys.data[j], keys.sizes[j]);
+  }
+  bench_report("get-hit", n, start, check);
+
+  char **batch = rhmapper_calloc(n, sizeof(char *));
+  size_t *sizes = rhmapper_calloc(n, sizeof(size_t));
+  size_t *out = rhmapper_calloc(n, sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    size_t j = bench_random() % n;
+    batch[i] = keys.data[j];
+    sizes[i] = keys.sizes[j];
+  }
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_get(rh, batch[i], sizes[i]);
+  }
+  bench_report("get-seq", n, start, check);
+  start = bench_now();
+  check = 0;
+  rhmapper_get_many(rh, batch, sizes, n, out);
+  for (size_t i = 0; i < n; i++) {
+    check += out[i];
+  }
+  bench_report("get-many", n, start, check);
+  free(batch);
+  free(sizes);
+  free(out);
+
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_get(rh, misses.data[i], misses.sizes[i]) ==
+             (size_t)RHMAPPER_EMPTY_VALUE;
+  }
+  bench_report("get-miss", n, start, check);
+
+  start = bench_now();
+  rhmapper_save(rh, "bench.rhm");
+  bench_report("save", n, start, rh->size);
+  start = bench_now();
+  rhmapper_frozen_t *fz = rhmapper_freeze(rh);
+  bench_report("freeze", n, start, fz->size);
+  rhmapper_destroy(rh);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t j = bench_random() % n;
+    check += rhmapper_frozen_get(fz, keys.data[j], keys.sizes[j]);
+  }
+  bench_report("get-mph", n, start, check);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    check += rhmapper_frozen_get(fz, misses.data[i], misses.sizes[i]) ==
+             (size_t)RHMAPPER_EMPTY_VALUE;
+  }
+  bench_report("miss-mph", n, start, check);
+  rhmapper_frozen_destroy(fz);
+  start = bench_now();
+  rh = rhmapper_open_mmap("bench.rhm");
+  bench_report("open", n, start, rh->size);
+  start = bench_now();
+  check = 0;
+  for (size_t i = 0; i < n; i++) {
+    size_t j = bench_random() % n;
+    check += rhmapper_get(rh, keys.data[j], keys.sizes[j]);
+  }
+  bench_report("get-mmap", n, start, check);
+  rhmapper_close_mmap(rh);
+  remove("bench.rhm");
+  bench_keys_destroy(misses);
+
+#ifndef RHMAPPER_COMPACT
+  for (size_t threads = 1; threads <= 64; threads *= 2) {
+    bench_sharded(keys, threads);
+  }
+#endif
+
+  bench_u64(n);
+  bench_stream(keys);
+
+  bench_hashes("4-32 byte", keys);
+  bench_keys_destroy(keys);
+  keys = bench_keys_create(n, 4, 16);
+  bench_hashes("4-16 byte", keys);
+  bench_keys_destroy(keys);
+  keys = bench_keys_create(n / 8, 64, 256);
+  bench_hashes("64-256 byte", keys);
+  bench_keys_destroy(keys);
+  return 0;
+}
@@ -2,9 +2,13 @@
 #define BBTEX_RHMAPPER_H
 
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#ifdef RHMAPPER_STATS
+#include <time.h>
+#endif
 
 #define XXH_INLINE_ALL
 #include "xxhash.h"
@@ -12,14 +16,114 @@
 #define RHMAPPER_GROW_FACTOR 2
 #define RHMAPPER_GROW_RATIO 8 / 10
 #define RHMAPPER_EMPTY_VALUE -1
+#define RHMAPPER_RETRY_VALUE -2
+#define RHMAPPER_CHUNK_MIN 4096
+#define RHMAPPER_CHUNK_MAX (1 << 20)
+#define RHMAPPER_BATCH 16
+#define RHMAPPER_MIGRATE_STEP 64
+#define RHMAPPER_REVERSE_MIN 256
+#define RHMAPPER_STATS_PSL 32
+#ifndef RHMAPPER_CACHE_SIZE
+#define RHMAPPER_CACHE_SIZE 512
+#endif
+#ifdef RHMAPPER_CACHE
+typedef char rhmapper_cache_check
+    [RHMAPPER_CACHE_SIZE >= 2 &&
+             (RHMAPPER_CACHE_SIZE & (RHMAPPER_CACHE_SIZE - 1)) == 0
+         ? 1
+         : -1];
+#endif
+#ifndef RHMAPPER_FILTER_BITS
+#define RHMAPPER_FILTER_BITS 8
+#endif
+#define RHMAPPER_FILTER_WORDS 8
+#define RHMAPPER_FILTER_BLOCK(filter, hash)                              \
+  ((uint64_t *)(((uintptr_t)(filter).data + 63) & ~(uintptr_t)63) +    \
+   ((hash) >> 32 & (filter).mask) * RHMAPPER_FILTER_WORDS)
 
-#define RHMAPPER_HASH(data, size) XXH64(data, size, 0)
-#define RHMAPPER_MEASURE(index, hash, capacity) \
-  ((capacity + index % capacity - hash % capacity) % capacity)
-#define RHMAPPER_RANK(new, old)             \
-  (RHMAPPER_MEASURE(index, new, capacity) > \
-   RHMAPPER_MEASURE(index, old, capacity))
+#ifndef RHMAPPER_HASH
+#define RHMAPPER_HASH(data, size) rhmapper_hash_xxh3(data, size)
+#endif
+#define RHMAPPER_DIGEST(data, size) \
+  ((rhmapper_hash_t)RHMAPPER_HASH(data, size))
+#if defined(RHMAPPER_CACHE) && defined(RHMAPPER_CONCURRENT)
+#error "RHMAPPER_CACHE is filled by rhmapper_get and cannot be used with RHMAPPER_CONCURRENT"
+#endif
+#if defined(RHMAPPER_FILTER) && defined(RHMAPPER_CONCURRENT)
+#error "RHMAPPER_FILTER is updated in place and cannot be used with RHMAPPER_CONCURRENT"
+#endif
+#ifdef RHMAPPER_COMPACT
+#ifdef RHMAPPER_CONCURRENT
+#error "RHMAPPER_COMPACT relocates keys and cannot be used with RHMAPPER_CONCURRENT"
+#endif
+#define RHMAPPER_SIZE_MAX UINT16_MAX
+#define RHMAPPER_VALUE_MAX UINT32_MAX
+typedef uint32_t rhmapper_hash_t;
+typedef uint32_t rhmapper_ref_t;
+#else
+#define RHMAPPER_SIZE_MAX UINT32_MAX
+#define RHMAPPER_VALUE_MAX SIZE_MAX
+typedef size_t rhmapper_hash_t;
+typedef uintptr_t rhmapper_ref_t;
+#endif
+#ifdef RHMAPPER_MODULO
+#define RHMAPPER_CAPACITY(capacity) (capacity)
+#define RHMAPPER_SLOT(index, capacity) ((index) % (capacity))
+#else
+#define RHMAPPER_CAPACITY(capacity) rhmapper_internal_pow2(capacity)
+#define RHMAPPER_SLOT(index, capacity) ((index) & ((capacity) - 1))
+#endif
 #define RHMAPPER_NEXT(index) index + 1
+#ifndef RHMAPPER_INLINE_SIZE
+#define RHMAPPER_INLINE_SIZE sizeof(rhmapper_ref_t)
+#endif
+typedef char rhmapper_inline_check
+    [RHMAPPER_INLINE_SIZE <= sizeof(rhmapper_ref_t) ? 1 : -1];
+#define RHMAPPER_INLINE(size) ((size) <= RHMAPPER_INLINE_SIZE)
+#define RHMAPPER_KEY(table, kv)                   \
+  (RHMAPPER_INLINE((kv).size) ? (char *)&(kv).data \
+                              : (char *)((table)->base + (kv).data))
+#define RHMAPPER_EQUAL(table, kv, key, word, size) \
+  (RHMAPPER_INLINE(size) ? (kv).data == (word)     \
+                         : !memcmp(key, RHMAPPER_KEY(table, kv), size))
+#ifdef __GNUC__
+#define RHMAPPER_PREFETCH(ptr) __builtin_prefetch(ptr)
+#else
+#define RHMAPPER_PREFETCH(ptr) (void)(ptr)
+#endif
+
+#ifdef RHMAPPER_CONCURRENT
+#include <stdatomic.h>
+#define RHMAPPER_ATOMIC(type) _Atomic(type)
+#define RHMAPPER_LOAD(ptr) atomic_load_explicit(&(ptr), memory_order_acquire)
+#define RHMAPPER_STABLE(table, sequence)      \
+  (atomic_thread_fence(memory_order_acquire), \
+   atomic_load_explicit(&(table)->sequence, memory_order_relaxed) == (sequence))
+#else
+#define RHMAPPER_ATOMIC(type) type
+#define RHMAPPER_LOAD(ptr) (ptr)
+#define RHMAPPER_STABLE(table, sequence) ((void)(sequence), 1)
+#endif
+
+#ifdef RHMAPPER_SIMD
+#define RHMAPPER_TAG(hash) \
+  ((uint8_t)(0x80 | (hash) >> (sizeof(rhmapper_hash_t) * 8 - 7)))
+#if defined(__AVX2__) && !defined(RHMAPPER_SWAR)
+#include <immintrin.h>
+#define RHMAPPER_GROUP 32
+#define RHMAPPER_STRIDE 1
+typedef uint32_t rhmapper_mask_t;
+#elif defined(__SSE2__) && !defined(RHMAPPER_SWAR)
+#include <emmintrin.h>
+#define RHMAPPER_GROUP 16
+#define RHMAPPER_STRIDE 1
+typedef uint32_t rhmapper_mask_t;
+#else
+#define RHMAPPER_GROUP 8
+#define RHMAPPER_STRIDE 8
+typedef uint64_t rhmapper_mask_t;
+#endif
+#endif
 
 void *rhmapper_calloc(size_t n, size_t size) {
   void *result = calloc(n, size);
@@ -27,18 +131,145 @@ void *rhmapper_calloc(size_t n, size_t size) {
   return result;
 }
 
+void *rhmapper_malloc(size_t size) {
+  void *result = malloc(size);
+  assert(result);
+  return result;
+}
+
+size_t rhmapper_internal_pow2(size_t n) {
+  size_t result = 1;
+  while (result < n) {
+    result <<= 1;
+  }
+  return result;
+}
+
+size_t rhmapper_hash_xxh3(const char *data, size_t size) {
+  if (size <= 16) {
+    return XXH3_len_0to16_64b((const xxh_u8 *)data, size, XXH3_kSecret, 0);
+  }
+  return XXH3_64bits(data, size);
+}
+
+size_t rhmapper_hash_xxh64(const char *data, size_t size) {
+  return XXH64(data, size, 0);
+}
+
+size_t rhmapper_hash_mul(const char *data, size_t size) {
+  uint64_t hash = size * 0x9E3779B97F4A7C15ull;
+  uint64_t word;
+  for (; size >= sizeof(word); size -= sizeof(word)) {
+    memcpy(&word, data, sizeof(word));
+    hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+    data += sizeof(word);
+  }
+  word = 0;
+  memcpy(&word, data, size);
+  hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+  return hash ^ hash >> 32;
+}
+
+rhmapper_ref_t rhmapper_internal_word(const char *key, size_t size) {
+  rhmapper_ref_t word = 0;
+  if (RHMAPPER_INLINE(size)) {
+    memcpy(&word, key, size);
+  }
+  return word;
+}
+
+#ifdef RHMAPPER_SIMD
+unsigned rhmapper_internal_ctz(rhmapper_mask_t mask) {
+#ifdef __GNUC__
+  return __builtin_ctzll(mask);
+#else
+  unsigned result = 0;
+  while (!(mask & 1)) {
+    mask >>= 1;
+    result++;
+  }
+  return result;
+#endif
+}
+
+rhmapper_mask_t rhmapper_internal_match(const uint8_t *tags, uint8_t tag) {
+#if RHMAPPER_GROUP == 32
+  __m256i group = _mm256_loadu_si256((const __m256i *)tags);
+  return _mm256_movemask_epi8(_mm256_cmpeq_epi8(group, _mm256_set1_epi8(tag)));
+#elif RHMAPPER_GROUP == 16
+  __m128i group = _mm_loadu_si128((const __m128i *)tags);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag)));
+#else
+  uint64_t group;
+  memcpy(&group, tags, sizeof(group));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  group = __builtin_bswap64(group);
+#endif
+  group ^= 0x0101010101010101ull * tag;
+  return (group - 0x0101010101010101ull) & ~group & 0x8080808080808080ull;
+#endif
+}
+#endif
+
 typedef struct rhmapper rhmapper_t;
+typedef struct rhmapper_table rhmapper_table_t;
+typedef struct rhmapper_chunk rhmapper_chunk_t;
 typedef struct rhmapper_string rhmapper_string_t;
-typedef struct rhmapper_kv_remote rhmapper_kv_remote_t;
 typedef struct rhmapper_kv rhmapper_kv_t;
+typedef struct rhmapper_retired rhmapper_retired_t;
+typedef struct rhmapper_stats rhmapper_stats_t;
+typedef struct rhmapper_filter rhmapper_filter_t;
+
+struct rhmapper_filter {
+  uint64_t *data;
+  size_t mask;
+};
 
 struct rhmapper {
   size_t size;
-  size_t capacity;
-  rhmapper_kv_t *array;
+  RHMAPPER_ATOMIC(rhmapper_table_t *) table;
+#ifdef RHMAPPER_INCREMENTAL
+  RHMAPPER_ATOMIC(rhmapper_table_t *) old;
+  size_t cursor;
+#endif
+  rhmapper_chunk_t *arena;
 #ifdef RHMAPPER_REVERSE
-  rhmapper_string_t *reverse;
+  RHMAPPER_ATOMIC(rhmapper_string_t *) reverse;
+  size_t reverse_capacity;
+#endif
+#ifdef RHMAPPER_CONCURRENT
+  atomic_size_t epoch;
+  atomic_size_t readers[2];
+  rhmapper_retired_t *pending;
+  rhmapper_retired_t *limbo;
+#endif
+#ifdef RHMAPPER_STATS
+  size_t grows;
+  clock_t grow_clock;
+#endif
+#ifdef RHMAPPER_CACHE
+  rhmapper_kv_t *cache;
+  size_t hits;
+  size_t misses;
 #endif
+#ifdef RHMAPPER_FILTER
+  rhmapper_filter_t filter;
+#ifdef RHMAPPER_INCREMENTAL
+  rhmapper_filter_t filter_old;
+#endif
+#endif
+};
+
+struct rhmapper_retired {
+  rhmapper_retired_t *next;
+  void *data;
+};
+
+struct rhmapper_chunk {
+  rhmapper_chunk_t *next;
+  size_t used;
+  size_t capacity;
+  char data[];
 };
 
 struct rhmapper_string {
@@ -46,141 +277,919 @@ struct rhmapper_string {
   char *data;
 };
 
-struct rhmapper_kv_remote {
-  size_t value;
-  rhmapper_string_t key;
+#ifdef RHMAPPER_COMPACT
+struct rhmapper_kv {
+  uint32_t hash;
+  uint32_t value;
+  uint32_t data;
+  uint16_t size;
+  uint16_t psl;
 };
-
+#else
 struct rhmapper_kv {
   size_t hash;
-  rhmapper_kv_remote_t *remote;
+  size_t value;
+  uintptr_t data;
+  uint32_t size;
+  uint32_t psl;
 };
+#endif
 
-rhmapper_t *rhmapper_create(size_t capacity) {
-  assert(capacity >= 1);
+struct rhmapper_table {
+  size_t capacity;
+  uintptr_t base;
+#ifdef RHMAPPER_CONCURRENT
+  atomic_size_t sequence;
+#endif
+  rhmapper_kv_t *array;
+#ifdef RHMAPPER_SIMD
+  uint8_t *tags;
+#endif
+};
+
+#ifdef RHMAPPER_STATS
+struct rhmapper_stats {
+  size_t size;
+  size_t capacity;
+  double load;
+  double psl_mean;
+  size_t psl_max;
+  size_t psl_histogram[RHMAPPER_STATS_PSL];
+  double miss_mean;
+  size_t table_bytes;
+  size_t key_bytes;
+  size_t arena_bytes;
+  size_t reverse_bytes;
+  size_t grows;
+  double grow_seconds;
+  size_t cache_hits;
+  size_t cache_misses;
+  size_t filter_bytes;
+};
+#endif
+
+rhmapper_table_t *rhmapper_internal_table(size_t capacity) {
+  size_t size = sizeof(rhmapper_table_t) + capacity * sizeof(rhmapper_kv_t);
+#ifdef RHMAPPER_SIMD
+  size += capacity + RHMAPPER_GROUP - 1;
+#endif
+  rhmapper_table_t *table = rhmapper_calloc(1, size);
+  table->capacity = capacity;
+  table->base = 0;
+  table->array = (rhmapper_kv_t *)(table + 1);
+#ifdef RHMAPPER_SIMD
+  table->tags = (uint8_t *)(table->array + capacity);
+#endif
+  return table;
+}
+
+#ifdef RHMAPPER_FILTER
+uint64_t rhmapper_internal_bit(uint64_t hash, size_t word) {
+  static const uint32_t salts[RHMAPPER_FILTER_WORDS] = {
+      0x47B6137B, 0x44974D91, 0x8824AD5B, 0xA2B7289D,
+      0x705495C7, 0x2DF1424B, 0x9EFC4947, 0x5C6BFB31,
+  };
+  return (uint64_t)1 << ((uint32_t)hash * salts[word] >> 26);
+}
+
+void rhmapper_internal_mark(rhmapper_filter_t filter, size_t hash) {
+  uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+  uint64_t *block = RHMAPPER_FILTER_BLOCK(filter, mixed);
+  for (size_t i = 0; i < RHMAPPER_FILTER_WORDS; i++) {
+    block[i] |= rhmapper_internal_bit(mixed, i);
+  }
+}
+
+int rhmapper_internal_contains(rhmapper_filter_t filter, size_t hash) {
+  uint64_t mixed = (uint64_t)hash * 0x9E3779B97F4A7C15ull;
+  uint64_t *block = RHMAPPER_FILTER_BLOCK(filter, mixed);
+  uint64_t missing = 0;
+  for (size_t i = 0; i < RHMAPPER_FILTER_WORDS; i++) {
+    missing |= rhmapper_internal_bit(mixed, i) & ~block[i];
+  }
+  return missing == 0;
+}
+
+size_t rhmapper_internal_filter_blocks(size_t capacity) {
+  return rhmapper_internal_pow2(
+      capacity * RHMAPPER_FILTER_BITS / (RHMAPPER_FILTER_WORDS * 64));
+}
+
+rhmapper_filter_t rhmapper_internal_filter(size_t capacity) {
+  size_t blocks = rhmapper_internal_filter_blocks(capacity);
+  rhmapper_filter_t filter = {
+      .data = rhmapper_calloc((blocks + 1) * RHMAPPER_FILTER_WORDS,
+                              sizeof(uint64_t)),
+      .mask = blocks - 1,
+  };
+  return filter;
+}
+
+size_t rhmapper_internal_filter_bytes(rhmapper_filter_t filter) {
+  return filter.data == NULL ? 0
+                             : (filter.mask + 2) * RHMAPPER_FILTER_WORDS *
+                                   sizeof(uint64_t);
+}
+#endif
 
+rhmapper_t *rhmapper_internal_create(rhmapper_table_t *table) {
   rhmapper_t *rh;
   rh = rhmapper_calloc(1, sizeof(rhmapper_t));
   rh->size = 0;
-  rh->capacity = capacity;
-  rh->array = rhmapper_calloc(capacity, sizeof(rhmapper_kv_t));
+  rh->table = table;
+#ifdef RHMAPPER_INCREMENTAL
+  rh->old = NULL;
+  rh->cursor = 0;
+#endif
+  rh->arena = NULL;
 #ifdef RHMAPPER_REVERSE
-  rh->reverse = rhmapper_calloc(capacity, sizeof(rhmapper_kv_t));
+  rh->reverse = NULL;
+  rh->reverse_capacity = 0;
+#endif
+#ifdef RHMAPPER_CONCURRENT
+  atomic_init(&rh->epoch, 0);
+  atomic_init(&rh->readers[0], 0);
+  atomic_init(&rh->readers[1], 0);
+  rh->pending = NULL;
+  rh->limbo = NULL;
+#endif
+#ifdef RHMAPPER_STATS
+  rh->grows = 0;
+  rh->grow_clock = 0;
+#endif
+#ifdef RHMAPPER_CACHE
+  rh->cache = rhmapper_calloc(RHMAPPER_CACHE_SIZE, sizeof(rhmapper_kv_t));
+  rh->hits = 0;
+  rh->misses = 0;
+#endif
+#ifdef RHMAPPER_FILTER
+  rh->filter.data = NULL;
+  rh->filter.mask = 0;
+#ifdef RHMAPPER_INCREMENTAL
+  rh->filter_old.data = NULL;
+  rh->filter_old.mask = 0;
+#endif
 #endif
 
   return rh;
 }
 
-void rhmapper_destroy(rhmapper_t *rh) {
-  const size_t size = rh->capacity;
-  for (size_t i = 0; i < size; i++) {
-    rhmapper_kv_t it = rh->array[i];
-    if (it.remote != NULL) {
-      free(it.remote->key.data);
-      free(it.remote);
+rhmapper_t *rhmapper_create(size_t capacity) {
+  assert(capacity >= 1);
+  capacity = RHMAPPER_CAPACITY(capacity);
+#ifdef RHMAPPER_SIMD
+  if (capacity < RHMAPPER_GROUP) {
+    capacity = RHMAPPER_GROUP;
+  }
+#endif
+
+  rhmapper_t *rh = rhmapper_internal_create(rhmapper_internal_table(capacity));
+#ifdef RHMAPPER_FILTER
+  rh->filter = rhmapper_internal_filter(capacity);
+#endif
+  return rh;
+}
+
+void rhmapper_internal_release(rhmapper_retired_t *list) {
+  while (list != NULL) {
+    rhmapper_retired_t *next = list->next;
+    free(list->data);
+    free(list);
+    list = next;
+  }
+}
+
+#ifdef RHMAPPER_CONCURRENT
+size_t rhmapper_internal_enter(rhmapper_t *rh) {
+  for (;;) {
+    size_t epoch = atomic_load(&rh->epoch);
+    atomic_fetch_add(&rh->readers[epoch & 1], 1);
+    if (atomic_load(&rh->epoch) == epoch) {
+      return epoch;
+    }
+    atomic_fetch_sub(&rh->readers[epoch & 1], 1);
+  }
+}
+
+void rhmapper_internal_exit(rhmapper_t *rh, size_t epoch) {
+  atomic_fetch_sub_explicit(&rh->readers[epoch & 1], 1, memory_order_release);
+}
+
+void rhmapper_internal_reclaim(rhmapper_t *rh) {
+  size_t epoch = atomic_load(&rh->epoch);
+  if (rh->limbo != NULL && atomic_load(&rh->readers[(epoch - 1) & 1]) == 0) {
+    rhmapper_internal_release(rh->limbo);
+    rh->limbo = NULL;
+  }
+  if (rh->limbo == NULL && rh->pending != NULL) {
+    rh->limbo = rh->pending;
+    rh->pending = NULL;
+    atomic_store(&rh->epoch, epoch + 1);
+    if (atomic_load(&rh->readers[epoch & 1]) == 0) {
+      rhmapper_internal_release(rh->limbo);
+      rh->limbo = NULL;
     }
   }
-  free(rh->array);
+}
+
+void rhmapper_internal_write_begin(rhmapper_table_t *table) {
+  size_t sequence =
+      atomic_load_explicit(&table->sequence, memory_order_relaxed);
+  atomic_store_explicit(&table->sequence, sequence + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+}
+
+void rhmapper_internal_write_end(rhmapper_table_t *table) {
+  size_t sequence =
+      atomic_load_explicit(&table->sequence, memory_order_relaxed);
+  atomic_store_explicit(&table->sequence, sequence + 1, memory_order_release);
+}
+#else
+size_t rhmapper_internal_enter(rhmapper_t *rh) {
+  (void)rh;
+  return 0;
+}
+
+void rhmapper_internal_exit(rhmapper_t *rh, size_t epoch) {
+  (void)rh;
+  (void)epoch;
+}
+
+void rhmapper_internal_write_begin(rhmapper_table_t *table) {
+  (void)table;
+}
+
+void rhmapper_internal_write_end(rhmapper_table_t *table) {
+  (void)table;
+}
+#endif
+
+void rhmapper_internal_retire(rhmapper_t *rh, void *data) {
+#ifdef RHMAPPER_CONCURRENT
+  rhmapper_retired_t *retired = rhmapper_malloc(sizeof(rhmapper_retired_t));
+  retired->next = rh->pending;
+  retired->data = data;
+  rh->pending = retired;
+  rhmapper_internal_reclaim(rh);
+#else
+  (void)rh;
+  free(data);
+#endif
+}
+
+void rhmapper_destroy(rhmapper_t *rh) {
+  rhmapper_chunk_t *chunk = rh->arena;
+  while (chunk != NULL) {
+    rhmapper_chunk_t *next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(rh->table);
+#ifdef RHMAPPER_CACHE
+  free(rh->cache);
+#endif
+#ifdef RHMAPPER_FILTER
+  free(rh->filter.data);
+#ifdef RHMAPPER_INCREMENTAL
+  free(rh->filter_old.data);
+#endif
+#endif
+#ifdef RHMAPPER_INCREMENTAL
+  free(rh->old);
+#endif
 #ifdef RHMAPPER_REVERSE
   free(rh->reverse);
+#endif
+#ifdef RHMAPPER_CONCURRENT
+  rhmapper_internal_release(rh->pending);
+  rhmapper_internal_release(rh->limbo);
 #endif
   free(rh);
 }
 
-void rhmapper_internal_set(rhmapper_t *rh, rhmapper_kv_t kv, size_t index) {
-  size_t capacity = rh->capacity;
-#ifdef RHMAPPER_REVERSE
-  rh->reverse[kv.remote->value] = kv.remote->key;
+#ifdef RHMAPPER_COMPACT
+void *rhmapper_internal_alloc(rhmapper_t *rh, size_t size) {
+  rhmapper_chunk_t *chunk = rh->arena;
+  if (chunk == NULL || chunk->capacity - chunk->used < size) {
+    size_t capacity = RHMAPPER_CHUNK_MIN;
+    size_t used = 0;
+    if (chunk != NULL) {
+      capacity = chunk->capacity * RHMAPPER_GROW_FACTOR;
+      used = chunk->used;
+    }
+    while (capacity - used < size) {
+      capacity *= RHMAPPER_GROW_FACTOR;
+    }
+    chunk = realloc(chunk, sizeof(rhmapper_chunk_t) + capacity);
+    assert(chunk);
+    chunk->next = NULL;
+    chunk->used = used;
+    chunk->capacity = capacity;
+    rh->arena = chunk;
+    rh->table->base = (uintptr_t)chunk->data;
+#ifdef RHMAPPER_INCREMENTAL
+    if (rh->old != NULL) {
+      rh->old->base = (uintptr_t)chunk->data;
+    }
+#endif
+  }
+  assert(chunk->used + size <= UINT32_MAX);
+  void *result = chunk->data + chunk->used;
+  chunk->used += size;
+  return result;
+}
+#else
+void *rhmapper_internal_alloc(rhmapper_t *rh, size_t size) {
+  rhmapper_chunk_t *chunk = rh->arena;
+  if (chunk == NULL || chunk->capacity - chunk->used < size) {
+    size_t capacity = RHMAPPER_CHUNK_MIN;
+    if (chunk != NULL) {
+      capacity = chunk->capacity * RHMAPPER_GROW_FACTOR;
+    }
+    if (capacity > RHMAPPER_CHUNK_MAX) {
+      capacity = RHMAPPER_CHUNK_MAX;
+    }
+    if (capacity < size) {
+      capacity = size;
+    }
+    chunk = rhmapper_malloc(sizeof(rhmapper_chunk_t) + capacity);
+    chunk->next = rh->arena;
+    chunk->used = 0;
+    chunk->capacity = capacity;
+    rh->arena = chunk;
+  }
+  void *result = chunk->data + chunk->used;
+  chunk->used += size;
+  return result;
+}
+#endif
+
+void rhmapper_internal_store(
+    rhmapper_table_t *table, size_t slot, rhmapper_kv_t kv) {
+  table->array[slot] = kv;
+#ifdef RHMAPPER_SIMD
+  table->tags[slot] = RHMAPPER_TAG(kv.hash);
+  if (slot < RHMAPPER_GROUP - 1) {
+    table->tags[table->capacity + slot] = RHMAPPER_TAG(kv.hash);
+  }
 #endif
+}
+
+void rhmapper_internal_set(
+    rhmapper_table_t *table, rhmapper_kv_t kv, size_t index) {
+  size_t capacity = table->capacity;
   for (;;) {
-    rhmapper_kv_t stored = rh->array[index % capacity];
-    if (stored.remote == NULL) {
-      rh->array[index % capacity] = kv;
+    size_t slot = RHMAPPER_SLOT(index, capacity);
+    rhmapper_kv_t stored = table->array[slot];
+    if (stored.psl == 0) {
+      rhmapper_internal_store(table, slot, kv);
       return;
-    } else if (RHMAPPER_RANK(kv.hash, stored.hash)) {
-      rhmapper_kv_t tmp = kv;
+    } else if (kv.psl > stored.psl) {
+      rhmapper_internal_store(table, slot, kv);
       kv = stored;
-      rh->array[index % capacity] = tmp;
     }
     index = RHMAPPER_NEXT(index);
+    kv.psl++;
+  }
+}
+
+void rhmapper_internal_migrate(
+    rhmapper_t *rh, rhmapper_table_t *table, rhmapper_table_t *old,
+    size_t from, size_t to) {
+  (void)rh;
+  for (size_t i = from; i < to; i++) {
+    rhmapper_kv_t it = old->array[i];
+    if (it.psl != 0) {
+      it.psl = 1;
+      rhmapper_internal_set(table, it, it.hash);
+#ifdef RHMAPPER_FILTER
+      rhmapper_internal_mark(rh->filter, it.hash);
+#endif
+    }
   }
 }
 
+#ifdef RHMAPPER_INCREMENTAL
+void rhmapper_internal_step(rhmapper_t *rh, size_t step) {
+  size_t capacity = rh->old->capacity;
+  size_t to = capacity - rh->cursor < step ? capacity : rh->cursor + step;
+  rhmapper_internal_write_begin(rh->table);
+  rhmapper_internal_migrate(rh, rh->table, rh->old, rh->cursor, to);
+  rhmapper_internal_write_end(rh->table);
+  rh->cursor = to;
+  if (rh->cursor == capacity) {
+    rhmapper_table_t *old = rh->old;
+    rh->old = NULL;
+    rhmapper_internal_retire(rh, old);
+#ifdef RHMAPPER_FILTER
+    free(rh->filter_old.data);
+    rh->filter_old.data = NULL;
+#endif
+  }
+}
+#endif
+
 void rhmapper_grow(rhmapper_t *rh, size_t capacity) {
   assert(capacity >= rh->size);
-  size_t old_capacity = rh->capacity;
-  rhmapper_kv_t *old_array = rh->array;
-#ifdef RHMAPPER_REVERSE
-  free(rh->reverse);
-  rh->reverse = rhmapper_calloc(capacity, sizeof(rhmapper_kv_t));
+  capacity = RHMAPPER_CAPACITY(capacity);
+#ifdef RHMAPPER_SIMD
+  if (capacity < RHMAPPER_GROUP) {
+    capacity = RHMAPPER_GROUP;
+  }
 #endif
-  rh->array = rhmapper_calloc(capacity, sizeof(rhmapper_kv_t));
-  rh->capacity = capacity;
-  for (size_t i = old_capacity; i > 0; i--) {
-    rhmapper_kv_t it = old_array[i - 1];
-    if (it.remote != NULL) {
-      rhmapper_internal_set(rh, it, it.hash);
-    }
+#ifdef RHMAPPER_STATS
+  clock_t start = clock();
+#endif
+#ifdef RHMAPPER_INCREMENTAL
+  if (rh->old != NULL) {
+    rhmapper_internal_step(rh, rh->old->capacity);
   }
-  free(old_array);
+  rh->old = rh->table;
+  rh->cursor = 0;
+  rh->table = rhmapper_internal_table(capacity);
+  rh->table->base = rh->old->base;
+#ifdef RHMAPPER_FILTER
+  rh->filter_old = rh->filter;
+  rh->filter = rhmapper_internal_filter(capacity);
+#endif
+#else
+  rhmapper_table_t *old = rh->table;
+  rhmapper_table_t *table = rhmapper_internal_table(capacity);
+  table->base = old->base;
+#ifdef RHMAPPER_FILTER
+  free(rh->filter.data);
+  rh->filter = rhmapper_internal_filter(capacity);
+#endif
+  rhmapper_internal_migrate(rh, table, old, 0, old->capacity);
+  rh->table = table;
+  rhmapper_internal_retire(rh, old);
+#endif
+#ifdef RHMAPPER_STATS
+  rh->grows++;
+  rh->grow_clock += clock() - start;
+#endif
 }
 
-size_t rhmapper_put(rhmapper_t *rh, char *key, size_t size) {
-  size_t hash = RHMAPPER_HASH(key, size);
-  size_t capacity = rh->capacity;
+#ifdef RHMAPPER_SIMD
+size_t rhmapper_internal_probe(
+    rhmapper_table_t *table, char *key, size_t size, size_t hash,
+    size_t sequence, rhmapper_kv_t *found) {
+  size_t capacity = table->capacity;
   size_t index = hash;
+  uint32_t psl = 1;
+  uint8_t tag = RHMAPPER_TAG(hash);
+  rhmapper_ref_t word = rhmapper_internal_word(key, size);
   for (;;) {
-    rhmapper_kv_t it = rh->array[index % capacity];
-    if (it.remote == NULL) {
-      char *data = rhmapper_calloc(size, sizeof(char));
-      memcpy(data, key, size);
-      rhmapper_kv_remote_t *remote =
-          rhmapper_calloc(1, sizeof(rhmapper_kv_remote_t));
-      remote->value = rh->size++;
-      remote->key.data = data;
-      remote->key.size = size;
-      rhmapper_kv_t kv = {
-          .remote = remote,
-          .hash = hash,
-      };
-      if (rh->size > capacity * RHMAPPER_GROW_RATIO) {
-        rhmapper_grow(rh, rh->capacity * RHMAPPER_GROW_FACTOR);
+    size_t slot = RHMAPPER_SLOT(index, capacity);
+    rhmapper_mask_t empty = rhmapper_internal_match(table->tags + slot, 0);
+    rhmapper_mask_t match = rhmapper_internal_match(table->tags + slot, tag);
+    if (empty) {
+      match &= (empty & -empty) - 1;
+    }
+    while (match) {
+      size_t offset = rhmapper_internal_ctz(match) / RHMAPPER_STRIDE;
+      rhmapper_kv_t it = table->array[RHMAPPER_SLOT(slot + offset, capacity)];
+      if (it.hash == hash && it.size == size) {
+        if (!RHMAPPER_STABLE(table, sequence)) {
+          return RHMAPPER_RETRY_VALUE;
+        } else if (RHMAPPER_EQUAL(table, it, key, word, size)) {
+          *found = it;
+          return it.value;
+        }
       }
-      rhmapper_internal_set(rh, kv, kv.hash);
-      return kv.remote->value;
-    } else if (
-        it.hash == hash && it.remote->key.size == size &&
-        !memcmp(key, it.remote->key.data, size)) {
-      return it.remote->value;
-    } else {
-      index = RHMAPPER_NEXT(index);
+      match &= match - 1;
     }
+    size_t last = RHMAPPER_SLOT(slot + RHMAPPER_GROUP - 1, capacity);
+    if (empty || table->array[last].psl < psl + RHMAPPER_GROUP - 1) {
+      return RHMAPPER_EMPTY_VALUE;
+    }
+    index += RHMAPPER_GROUP;
+    psl += RHMAPPER_GROUP;
   }
 }
-
-size_t rhmapper_get(rhmapper_t *rh, char *key, size_t size) {
-  size_t hash = RHMAPPER_HASH(key, size);
-  size_t capacity = rh->capacity;
+#else
+size_t rhmapper_internal_probe(
+    rhmapper_table_t *table, char *key, size_t size, size_t hash,
+    size_t sequence, rhmapper_kv_t *found) {
+  size_t capacity = table->capacity;
   size_t index = hash;
+  uint32_t psl = 1;
+  rhmapper_ref_t word = rhmapper_internal_word(key, size);
   for (;;) {
-    rhmapper_kv_t it = rh->array[index % capacity];
-    if (it.remote == NULL) {
-      return RHMAPPER_EMPTY_VALUE;
-    } else if (RHMAPPER_RANK(hash, it.hash)) {
+    rhmapper_kv_t it = table->array[RHMAPPER_SLOT(index, capacity)];
+    if (it.psl < psl) {
       return RHMAPPER_EMPTY_VALUE;
-    } else if (
-        it.hash == hash && it.remote->key.size == size &&
-        !memcmp(key, it.remote->key.data, size)) {
-      return it.remote->value;
-    } else {
-      index = RHMAPPER_NEXT(index);
+    } else if (it.hash == hash && it.size == size) {
+      if (!RHMAPPER_STABLE(table, sequence)) {
+        return RHMAPPER_RETRY_VALUE;
+      } else if (RHMAPPER_EQUAL(table, it, key, word, size)) {
+        *found = it;
+        return it.value;
+      }
+    }
+    index = RHMAPPER_NEXT(index);
+    psl++;
+  }
+}
+#endif
+
+#ifdef RHMAPPER_CONCURRENT
+size_t rhmapper_internal_find(
+    rhmapper_table_t *table, char *key, size_t size, size_t hash,
+    rhmapper_kv_t *found) {
+  for (;;) {
+    size_t sequence =
+        atomic_load_explicit(&table->sequence, memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    size_t value =
+        rhmapper_internal_probe(table, key, size, hash, sequence, found);
+    if (value != (size_t)RHMAPPER_RETRY_VALUE &&
+        RHMAPPER_STABLE(table, sequence)) {
+      return value;
+    }
+  }
+}
+#else
+size_t rhmapper_internal_find(
+    rhmapper_table_t *table, char *key, size_t size, size_t hash,
+    rhmapper_kv_t *found) {
+  return rhmapper_internal_probe(table, key, size, hash, 0, found);
+}
+#endif
+
+size_t rhmapper_internal_search(
+    rhmapper_t *rh, char *key, size_t size, size_t hash,
+    rhmapper_kv_t *found) {
+#if defined(RHMAPPER_FILTER) && defined(RHMAPPER_INCREMENTAL)
+  if (!rhmapper_internal_contains(rh->filter, hash) &&
+      (rh->filter_old.data == NULL ||
+       !rhmapper_internal_contains(rh->filter_old, hash))) {
+    return RHMAPPER_EMPTY_VALUE;
+  }
+#elif defined(RHMAPPER_FILTER)
+  if (!rhmapper_internal_contains(rh->filter, hash)) {
+    return RHMAPPER_EMPTY_VALUE;
+  }
+#endif
+#ifdef RHMAPPER_INCREMENTAL
+  for (;;) {
+    rhmapper_table_t *old = RHMAPPER_LOAD(rh->old);
+    rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+    if (RHMAPPER_LOAD(rh->old) != old) {
+      continue;
+    }
+    size_t value = rhmapper_internal_find(table, key, size, hash, found);
+    if (value == (size_t)RHMAPPER_EMPTY_VALUE && old != NULL) {
+      value = rhmapper_internal_find(old, key, size, hash, found);
+    }
+    if (RHMAPPER_LOAD(rh->table) == table) {
+      return value;
+    }
+  }
+#else
+  return rhmapper_internal_find(
+      RHMAPPER_LOAD(rh->table), key, size, hash, found);
+#endif
+}
+
+#ifdef RHMAPPER_CACHE
+size_t rhmapper_internal_get(
+    rhmapper_t *rh, char *key, size_t size, size_t hash) {
+  rhmapper_kv_t *set =
+      &rh->cache[(hash & (RHMAPPER_CACHE_SIZE / 2 - 1)) * 2];
+  rhmapper_ref_t word = rhmapper_internal_word(key, size);
+  for (size_t way = 0; way < 2; way++) {
+    rhmapper_kv_t it = set[way];
+    if (it.psl != 0 && it.hash == hash && it.size == size &&
+        RHMAPPER_EQUAL(rh->table, it, key, word, size)) {
+      if (way == 1) {
+        set[1] = set[0];
+        set[0] = it;
+      }
+      rh->hits++;
+      return it.value;
+    }
+  }
+  rh->misses++;
+  rhmapper_kv_t found;
+  size_t value = rhmapper_internal_search(rh, key, size, hash, &found);
+  if (value != (size_t)RHMAPPER_EMPTY_VALUE) {
+    set[1] = found;
+  }
+  return value;
+}
+#else
+size_t rhmapper_internal_get(
+    rhmapper_t *rh, char *key, size_t size, size_t hash) {
+  rhmapper_kv_t found;
+  return rhmapper_internal_search(rh, key, size, hash, &found);
+}
+#endif
+
+rhmapper_kv_t rhmapper_internal_entry(
+    rhmapper_t *rh, char *key, size_t size, size_t hash, size_t value,
+    rhmapper_string_t *string) {
+  assert(size <= RHMAPPER_SIZE_MAX);
+  assert(value < RHMAPPER_VALUE_MAX);
+#ifdef RHMAPPER_CONCURRENT
+  if (rh->limbo != NULL) {
+    rhmapper_internal_reclaim(rh);
+  }
+#endif
+#ifdef RHMAPPER_INCREMENTAL
+  if (rh->old != NULL) {
+    rhmapper_internal_step(rh, RHMAPPER_MIGRATE_STEP);
+  }
+#endif
+  rhmapper_kv_t kv = {
+      .hash = hash,
+      .value = value,
+      .data = rhmapper_internal_word(key, size),
+      .size = size,
+      .psl = 1,
+  };
+  if (!RHMAPPER_INLINE(size) || string != NULL) {
+    char *data = rhmapper_internal_alloc(rh, size);
+    memcpy(data, key, size);
+    uintptr_t ref = (uintptr_t)data - rh->table->base;
+    if (!RHMAPPER_INLINE(size)) {
+      kv.data = ref;
     }
+    if (string != NULL) {
+      string->size = size;
+      string->data = (char *)ref;
+    }
+  }
+  size_t capacity = rh->table->capacity;
+  if (++rh->size > capacity * RHMAPPER_GROW_RATIO) {
+    rhmapper_grow(rh, capacity * RHMAPPER_GROW_FACTOR);
+  }
+  return kv;
+}
+
+void rhmapper_internal_publish(rhmapper_t *rh, rhmapper_kv_t kv) {
+  rhmapper_table_t *table = rh->table;
+  rhmapper_internal_write_begin(table);
+  rhmapper_internal_set(table, kv, kv.hash);
+  rhmapper_internal_write_end(table);
+#ifdef RHMAPPER_FILTER
+  rhmapper_internal_mark(rh->filter, kv.hash);
+#endif
+}
+
+#ifdef RHMAPPER_REVERSE
+void rhmapper_internal_reverse(rhmapper_t *rh, size_t capacity) {
+#ifdef RHMAPPER_CONCURRENT
+  rhmapper_string_t *reverse = rh->reverse;
+  rhmapper_string_t *grown = rhmapper_malloc(capacity * sizeof(*grown));
+  if (reverse != NULL) {
+    size_t size = rh->size < rh->reverse_capacity ? rh->size
+                                                   : rh->reverse_capacity;
+    memcpy(grown, reverse, size * sizeof(*grown));
+  }
+  rh->reverse = grown;
+  rhmapper_internal_retire(rh, reverse);
+#else
+  rh->reverse = realloc(rh->reverse, capacity * sizeof(rhmapper_string_t));
+  assert(rh->reverse);
+#endif
+  rh->reverse_capacity = capacity;
+}
+
+void rhmapper_internal_append(
+    rhmapper_t *rh, size_t value, rhmapper_string_t string) {
+  if (value >= rh->reverse_capacity) {
+    size_t capacity = rh->reverse_capacity * RHMAPPER_GROW_FACTOR;
+    rhmapper_internal_reverse(
+        rh, capacity < RHMAPPER_REVERSE_MIN ? RHMAPPER_REVERSE_MIN : capacity);
   }
+  rh->reverse[value] = string;
+}
+#endif
+
+size_t rhmapper_internal_put(
+    rhmapper_t *rh, char *key, size_t size, size_t hash) {
+  size_t value = rhmapper_internal_get(rh, key, size, hash);
+  if (value != (size_t)RHMAPPER_EMPTY_VALUE) {
+    return value;
+  }
+#ifdef RHMAPPER_REVERSE
+  rhmapper_string_t string;
+  rhmapper_kv_t kv =
+      rhmapper_internal_entry(rh, key, size, hash, rh->size, &string);
+  rhmapper_internal_append(rh, kv.value, string);
+#else
+  rhmapper_kv_t kv =
+      rhmapper_internal_entry(rh, key, size, hash, rh->size, NULL);
+#endif
+  rhmapper_internal_publish(rh, kv);
+  return kv.value;
+}
+
+size_t rhmapper_hash(const char *key, size_t size) {
+  return RHMAPPER_DIGEST(key, size);
+}
+
+size_t rhmapper_put_hashed(
+    rhmapper_t *rh, char *key, size_t size, size_t hash) {
+  return rhmapper_internal_put(rh, key, size, (rhmapper_hash_t)hash);
+}
+
+size_t rhmapper_put(rhmapper_t *rh, char *key, size_t size) {
+  return rhmapper_internal_put(rh, key, size, RHMAPPER_DIGEST(key, size));
+}
+
+size_t rhmapper_get_hashed(
+    rhmapper_t *rh, char *key, size_t size, size_t hash) {
+  size_t epoch = rhmapper_internal_enter(rh);
+  size_t value =
+      rhmapper_internal_get(rh, key, size, (rhmapper_hash_t)hash);
+  rhmapper_internal_exit(rh, epoch);
+  return value;
+}
+
+size_t rhmapper_get(rhmapper_t *rh, char *key, size_t size) {
+  return rhmapper_get_hashed(rh, key, size, RHMAPPER_DIGEST(key, size));
+}
+
+void rhmapper_internal_prefetch(
+    rhmapper_t *rh, char **keys, size_t *sizes, size_t n, size_t ahead,
+    size_t *hashes) {
+  rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+  for (size_t i = n; i < n + ahead; i++) {
+    RHMAPPER_PREFETCH(keys[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = RHMAPPER_DIGEST(keys[i], sizes[i]);
+    size_t slot = RHMAPPER_SLOT(hashes[i], table->capacity);
+    RHMAPPER_PREFETCH(&table->array[slot]);
+#ifdef RHMAPPER_SIMD
+    RHMAPPER_PREFETCH(&table->tags[slot]);
+#endif
+  }
+}
+
+void rhmapper_internal_prefetch_keys(rhmapper_t *rh, size_t n, size_t *hashes) {
+  rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+  for (size_t i = 0; i < n; i++) {
+    rhmapper_kv_t it = table->array[RHMAPPER_SLOT(hashes[i], table->capacity)];
+    if (it.hash == hashes[i] && !RHMAPPER_INLINE(it.size)) {
+      RHMAPPER_PREFETCH(RHMAPPER_KEY(table, it));
+    }
+  }
+}
+
+void rhmapper_get_many(
+    rhmapper_t *rh, char **keys, size_t *sizes, size_t n, size_t *out) {
+  size_t hashes[2][RHMAPPER_BATCH];
+  size_t batch = n < RHMAPPER_BATCH ? n : RHMAPPER_BATCH;
+  size_t epoch = rhmapper_internal_enter(rh);
+  rhmapper_internal_prefetch(rh, keys, sizes, batch, 0, hashes[0]);
+  for (size_t i = 0, k = 0; i < n; k ^= 1) {
+    size_t next = n - i - batch < RHMAPPER_BATCH ? n - i - batch
+                                                 : RHMAPPER_BATCH;
+    size_t ahead = n - i - batch - next < RHMAPPER_BATCH
+                       ? n - i - batch - next
+                       : RHMAPPER_BATCH;
+    rhmapper_internal_prefetch(
+        rh, keys + i + batch, sizes + i + batch, next, ahead, hashes[k ^ 1]);
+    rhmapper_internal_prefetch_keys(rh, batch, hashes[k]);
+    for (size_t j = 0; j < batch; j++) {
+      out[i + j] =
+          rhmapper_internal_get(rh, keys[i + j], sizes[i + j], hashes[k][j]);
+    }
+    i += batch;
+    batch = next;
+  }
+  rhmapper_internal_exit(rh, epoch);
+}
+
+void rhmapper_put_many(
+    rhmapper_t *rh, char **keys, size_t *sizes, size_t n, size_t *out) {
+  size_t hashes[2][RHMAPPER_BATCH];
+  size_t batch = n < RHMAPPER_BATCH ? n : RHMAPPER_BATCH;
+  rhmapper_internal_prefetch(rh, keys, sizes, batch, 0, hashes[0]);
+  for (size_t i = 0, k = 0; i < n; k ^= 1) {
+    size_t next = n - i - batch < RHMAPPER_BATCH ? n - i - batch
+                                                 : RHMAPPER_BATCH;
+    size_t ahead = n - i - batch - next < RHMAPPER_BATCH
+                       ? n - i - batch - next
+                       : RHMAPPER_BATCH;
+    rhmapper_internal_prefetch(
+        rh, keys + i + batch, sizes + i + batch, next, ahead, hashes[k ^ 1]);
+    for (size_t j = 0; j < batch; j++) {
+      out[i + j] =
+          rhmapper_internal_put(rh, keys[i + j], sizes[i + j], hashes[k][j]);
+    }
+    i += batch;
+    batch = next;
+  }
+}
+
+void rhmapper_reserve(rhmapper_t *rh, size_t n) {
+  size_t capacity = rh->table->capacity;
+  while (capacity * RHMAPPER_GROW_RATIO < n) {
+    capacity *= RHMAPPER_GROW_FACTOR;
+  }
+  if (capacity != rh->table->capacity) {
+    rhmapper_grow(rh, capacity);
+  }
+#ifdef RHMAPPER_REVERSE
+  if (n > rh->reverse_capacity) {
+    rhmapper_internal_reverse(rh, n);
+  }
+#endif
+}
+
+rhmapper_t *rhmapper_build(char **keys, size_t *sizes, size_t n) {
+  rhmapper_t *rh = rhmapper_create(1);
+  rhmapper_reserve(rh, n);
+  size_t *hashes = rhmapper_malloc((n + 1) * sizeof(size_t));
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = RHMAPPER_DIGEST(keys[i], sizes[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    if (i + RHMAPPER_BATCH < n) {
+      rhmapper_table_t *table = rh->table;
+      size_t slot = RHMAPPER_SLOT(hashes[i + RHMAPPER_BATCH], table->capacity);
+      RHMAPPER_PREFETCH(&table->array[slot]);
+      RHMAPPER_PREFETCH(keys[i + RHMAPPER_BATCH]);
+    }
+    rhmapper_internal_put(rh, keys[i], sizes[i], hashes[i]);
+  }
+  free(hashes);
+  return rh;
 }
 
 #ifdef RHMAPPER_REVERSE
 rhmapper_string_t rhmapper_rev(rhmapper_t *rh, size_t index) {
-  return rh->reverse[index];
+  size_t epoch = rhmapper_internal_enter(rh);
+  rhmapper_string_t key = RHMAPPER_LOAD(rh->reverse)[index];
+  key.data = (char *)(RHMAPPER_LOAD(rh->table)->base + (uintptr_t)key.data);
+  rhmapper_internal_exit(rh, epoch);
+  return key;
+}
+#endif
+
+#ifdef RHMAPPER_STATS
+void rhmapper_stats(rhmapper_t *rh, rhmapper_stats_t *out) {
+#ifdef RHMAPPER_INCREMENTAL
+  if (rh->old != NULL) {
+    rhmapper_internal_step(rh, rh->old->capacity);
+  }
+#endif
+  rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+  size_t capacity = table->capacity;
+  memset(out, 0, sizeof(*out));
+  out->size = rh->size;
+  out->capacity = capacity;
+  out->load = (double)rh->size / capacity;
+
+  size_t present = 0;
+  size_t psl_sum = 0;
+  size_t miss_sum = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      present++;
+      psl_sum += it.psl;
+      out->psl_max = it.psl > out->psl_max ? it.psl : out->psl_max;
+      size_t bucket = it.psl < RHMAPPER_STATS_PSL ? it.psl : RHMAPPER_STATS_PSL;
+      out->psl_histogram[bucket - 1]++;
+      out->key_bytes += it.size;
+    }
+    size_t psl = 1;
+    while (table->array[RHMAPPER_SLOT(i + psl - 1, capacity)].psl >= psl) {
+      psl++;
+    }
+    miss_sum += psl;
+  }
+  out->psl_mean = present ? (double)psl_sum / present : 0;
+  out->miss_mean = (double)miss_sum / capacity;
+
+  out->table_bytes =
+      sizeof(rhmapper_table_t) + capacity * sizeof(rhmapper_kv_t);
+#ifdef RHMAPPER_SIMD
+  out->table_bytes += capacity + RHMAPPER_GROUP - 1;
+#endif
+  for (rhmapper_chunk_t *chunk = rh->arena; chunk != NULL;
+       chunk = chunk->next) {
+    out->arena_bytes += sizeof(rhmapper_chunk_t) + chunk->capacity;
+  }
+#ifdef RHMAPPER_REVERSE
+  out->reverse_bytes = rh->reverse_capacity * sizeof(rhmapper_string_t);
+#endif
+  out->grows = rh->grows;
+  out->grow_seconds = (double)rh->grow_clock / CLOCKS_PER_SEC;
+#ifdef RHMAPPER_CACHE
+  out->cache_hits = rh->hits;
+  out->cache_misses = rh->misses;
+#endif
+#ifdef RHMAPPER_FILTER
+  out->filter_bytes = rhmapper_internal_filter_bytes(rh->filter);
+#endif
 }
 #endif
 
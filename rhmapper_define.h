@@ -0,0 +1,162 @@
+#ifndef BBTEX_RHMAPPER_DEFINE_H
+#define BBTEX_RHMAPPER_DEFINE_H
+
+#include "rhmapper.h"
+
+#ifdef RHMAPPER_REVERSE
+#define RHMAPPER_DEFINE_REVERSE(key_t) \
+  key_t *reverse;                      \
+  size_t reverse_capacity;
+#define RHMAPPER_DEFINE_REV(prefix, key_t)                           \
+  void prefix##_internal_append(prefix##_t *rh, key_t key) {         \
+    if (rh->size >= rh->reverse_capacity) {                          \
+      size_t capacity = rh->reverse_capacity * RHMAPPER_GROW_FACTOR; \
+      if (capacity < RHMAPPER_REVERSE_MIN) {                         \
+        capacity = RHMAPPER_REVERSE_MIN;                             \
+      }                                                              \
+      rh->reverse = realloc(rh->reverse, capacity * sizeof(key_t));  \
+      assert(rh->reverse);                                           \
+      rh->reverse_capacity = capacity;                               \
+    }                                                                \
+    rh->reverse[rh->size] = key;                                     \
+  }                                                                  \
+                                                                     \
+  key_t prefix##_rev(prefix##_t *rh, size_t index) {                 \
+    return rh->reverse[index];                                       \
+  }
+#define RHMAPPER_DEFINE_APPEND(prefix, rh, key) \
+  prefix##_internal_append(rh, key)
+#define RHMAPPER_DEFINE_RELEASE(rh) free((rh)->reverse)
+#else
+#define RHMAPPER_DEFINE_REVERSE(key_t)
+#define RHMAPPER_DEFINE_REV(prefix, key_t)
+#define RHMAPPER_DEFINE_APPEND(prefix, rh, key) (void)(rh)
+#define RHMAPPER_DEFINE_RELEASE(rh) (void)(rh)
+#endif
+
+#define RHMAPPER_DEFINE_PLAIN_FIELD
+#define RHMAPPER_DEFINE_PLAIN_HASH(kv, hash_fn) hash_fn((kv).key)
+#define RHMAPPER_DEFINE_PLAIN_MATCH(kv, hash) ((void)(hash), 1)
+#define RHMAPPER_DEFINE_PLAIN_STORE(kv, hash) (void)(kv)
+#define RHMAPPER_DEFINE_HASHED_FIELD size_t hash;
+#define RHMAPPER_DEFINE_HASHED_HASH(kv, hash_fn) (kv).hash
+#define RHMAPPER_DEFINE_HASHED_MATCH(kv, hash) ((kv).hash == (hash))
+#define RHMAPPER_DEFINE_HASHED_STORE(kv, hash) (kv).hash = (hash)
+
+#define RHMAPPER_DEFINE(prefix, key_t, hash_fn, eq_fn, value_t) \
+  RHMAPPER_DEFINE_MAPPER(prefix, key_t, hash_fn, eq_fn, value_t, PLAIN)
+#define RHMAPPER_DEFINE_HASHED(prefix, key_t, hash_fn, eq_fn, value_t) \
+  RHMAPPER_DEFINE_MAPPER(prefix, key_t, hash_fn, eq_fn, value_t, HASHED)
+
+#define RHMAPPER_DEFINE_MAPPER(prefix, key_t, hash_fn, eq_fn, value_t, mode) \
+  typedef struct prefix prefix##_t;                                          \
+  typedef struct prefix##_kv prefix##_kv_t;                                  \
+                                                                             \
+  struct prefix##_kv {                                                       \
+    key_t key;                                                               \
+    RHMAPPER_DEFINE_##mode##_FIELD                                           \
+    value_t value;                                                           \
+    uint32_t psl;                                                            \
+  };                                                                         \
+                                                                             \
+  struct prefix {                                                            \
+    size_t size;                                                             \
+    size_t capacity;                                                         \
+    prefix##_kv_t *array;                                                    \
+    RHMAPPER_DEFINE_REVERSE(key_t)                                           \
+  };                                                                         \
+                                                                             \
+  RHMAPPER_DEFINE_REV(prefix, key_t)                                         \
+                                                                             \
+  prefix##_t *prefix##_create(size_t capacity) {                             \
+    assert(capacity >= 1);                                                   \
+    prefix##_t *rh = rhmapper_calloc(1, sizeof(prefix##_t));                 \
+    rh->size = 0;                                                            \
+    rh->capacity = RHMAPPER_CAPACITY(capacity);                              \
+    rh->array = rhmapper_calloc(rh->capacity, sizeof(prefix##_kv_t));        \
+    return rh;                                                               \
+  }                                                                          \
+                                                                             \
+  void prefix##_destroy(prefix##_t *rh) {                                    \
+    free(rh->array);                                                         \
+    RHMAPPER_DEFINE_RELEASE(rh);                                             \
+    free(rh);                                                                \
+  }                                                                          \
+                                                                             \
+  void prefix##_internal_set(                                                \
+      prefix##_kv_t *array, size_t capacity, prefix##_kv_t kv,               \
+      size_t index) {                                                        \
+    for (;;) {                                                               \
+      size_t slot = RHMAPPER_SLOT(index, capacity);                          \
+      prefix##_kv_t stored = array[slot];                                    \
+      if (stored.psl == 0) {                                                 \
+        array[slot] = kv;                                                    \
+        return;                                                              \
+      } else if (kv.psl > stored.psl) {                                      \
+        array[slot] = kv;                                                    \
+        kv = stored;                                                         \
+      }                                                                      \
+      index = RHMAPPER_NEXT(index);                                          \
+      kv.psl++;                                                              \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  void prefix##_grow(prefix##_t *rh, size_t capacity) {                      \
+    assert(capacity >= rh->size);                                            \
+    prefix##_kv_t *array = rhmapper_calloc(capacity, sizeof(prefix##_kv_t)); \
+    for (size_t i = 0; i < rh->capacity; i++) {                              \
+      prefix##_kv_t it = rh->array[i];                                       \
+      if (it.psl != 0) {                                                     \
+        it.psl = 1;                                                          \
+        prefix##_internal_set(array, capacity, it,                           \
+                              RHMAPPER_DEFINE_##mode##_HASH(it, hash_fn));   \
+      }                                                                      \
+    }                                                                        \
+    free(rh->array);                                                         \
+    rh->array = array;                                                       \
+    rh->capacity = capacity;                                                 \
+  }                                                                          \
+                                                                             \
+  value_t prefix##_internal_get(prefix##_t *rh, key_t key, size_t hash) {    \
+    size_t index = hash;                                                     \
+    uint32_t psl = 1;                                                        \
+    for (;;) {                                                               \
+      prefix##_kv_t it = rh->array[RHMAPPER_SLOT(index, rh->capacity)];      \
+      if (it.psl < psl) {                                                    \
+        return (value_t)RHMAPPER_EMPTY_VALUE;                                \
+      } else if (RHMAPPER_DEFINE_##mode##_MATCH(it, hash) &&                 \
+                 eq_fn(it.key, key)) {                                       \
+        return it.value;                                                     \
+      }                                                                      \
+      index = RHMAPPER_NEXT(index);                                          \
+      psl++;                                                                 \
+    }                                                                        \
+  }                                                                          \
+                                                                             \
+  value_t prefix##_get(prefix##_t *rh, key_t key) {                          \
+    return prefix##_internal_get(rh, key, hash_fn(key));                     \
+  }                                                                          \
+                                                                             \
+  value_t prefix##_put(prefix##_t *rh, key_t key) {                          \
+    size_t hash = hash_fn(key);                                              \
+    value_t value = prefix##_internal_get(rh, key, hash);                    \
+    if (value != (value_t)RHMAPPER_EMPTY_VALUE) {                            \
+      return value;                                                          \
+    }                                                                        \
+    assert(rh->size < (value_t)RHMAPPER_EMPTY_VALUE);                        \
+    value = (value_t)rh->size;                                               \
+    RHMAPPER_DEFINE_APPEND(prefix, rh, key);                                 \
+    if (++rh->size > rh->capacity * RHMAPPER_GROW_RATIO) {                   \
+      prefix##_grow(rh, rh->capacity * RHMAPPER_GROW_FACTOR);                \
+    }                                                                        \
+    prefix##_kv_t kv = {                                                     \
+        .key = key,                                                          \
+        .value = value,                                                      \
+        .psl = 1,                                                            \
+    };                                                                       \
+    RHMAPPER_DEFINE_##mode##_STORE(kv, hash);                                \
+    prefix##_internal_set(rh->array, rh->capacity, kv, hash);                \
+    return value;                                                            \
+  }
+
+#endif
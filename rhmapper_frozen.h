@@ -0,0 +1,212 @@
+#ifndef BBTEX_RHMAPPER_FROZEN_H
+#define BBTEX_RHMAPPER_FROZEN_H
+
+#include "rhmapper.h"
+
+#define RHMAPPER_FROZEN_BUCKET 4
+#define RHMAPPER_FROZEN_PILOTS 65536
+#define RHMAPPER_FROZEN_SLACK 100
+
+typedef struct rhmapper_frozen rhmapper_frozen_t;
+
+struct rhmapper_frozen {
+  size_t size;
+  size_t slots;
+  size_t buckets;
+  uint64_t seed;
+  uint16_t *pilots;
+  uint32_t *ids;
+  uint32_t *offsets;
+  char *data;
+};
+
+uint64_t rhmapper_frozen_internal_mix(uint64_t x) {
+  x ^= x >> 32;
+  x *= 0xD6E8FEB86659FD93ull;
+  x ^= x >> 32;
+  x *= 0xD6E8FEB86659FD93ull;
+  return x ^ x >> 32;
+}
+
+size_t rhmapper_frozen_internal_reduce(uint64_t hash, size_t size) {
+  return (size_t)((hash >> 32) * (uint32_t)size >> 32);
+}
+
+size_t rhmapper_frozen_internal_position(
+    uint64_t hash, uint16_t pilot, size_t size) {
+  return rhmapper_frozen_internal_reduce(
+      rhmapper_frozen_internal_mix(
+          hash ^ (pilot + 1) * 0x9E3779B97F4A7C15ull),
+      size);
+}
+
+uint64_t rhmapper_frozen_internal_hash(
+    rhmapper_frozen_t *fz, const char *key, size_t size) {
+  if (size <= 16) {
+    return XXH3_len_0to16_64b((const xxh_u8 *)key, size, XXH3_kSecret,
+                              fz->seed);
+  }
+  return XXH3_64bits_withSeed(key, size, fz->seed);
+}
+
+int rhmapper_frozen_internal_build(rhmapper_frozen_t *fz, uint64_t *hashes) {
+  size_t n = fz->size;
+  size_t m = fz->slots;
+  size_t *starts = rhmapper_calloc(fz->buckets + 1, sizeof(size_t));
+  size_t *members = rhmapper_malloc(n * sizeof(size_t));
+  size_t *order = rhmapper_malloc(fz->buckets * sizeof(size_t));
+  uint64_t *taken = rhmapper_calloc(m / 64 + 1, sizeof(uint64_t));
+  size_t largest = 0;
+  for (size_t i = 0; i < n; i++) {
+    hashes[i] = rhmapper_frozen_internal_hash(
+        fz, fz->data + fz->offsets[i], fz->offsets[i + 1] - fz->offsets[i]);
+    starts[rhmapper_frozen_internal_reduce(hashes[i], fz->buckets) + 1]++;
+  }
+  for (size_t b = 0; b < fz->buckets; b++) {
+    largest = starts[b + 1] > largest ? starts[b + 1] : largest;
+    starts[b + 1] += starts[b];
+  }
+  for (size_t i = 0; i < n; i++) {
+    size_t b = rhmapper_frozen_internal_reduce(hashes[i], fz->buckets);
+    members[starts[b]++] = i;
+  }
+  for (size_t b = fz->buckets; b > 0; b--) {
+    starts[b] = starts[b - 1];
+  }
+  starts[0] = 0;
+
+  size_t *sizes = rhmapper_calloc(largest + 2, sizeof(size_t));
+  for (size_t b = 0; b < fz->buckets; b++) {
+    sizes[largest - (starts[b + 1] - starts[b]) + 1]++;
+  }
+  for (size_t s = 0; s <= largest; s++) {
+    sizes[s + 1] += sizes[s];
+  }
+  for (size_t b = 0; b < fz->buckets; b++) {
+    order[sizes[largest - (starts[b + 1] - starts[b])]++] = b;
+  }
+  free(sizes);
+
+  int built = 1;
+  for (size_t o = 0; o < fz->buckets && built; o++) {
+    size_t b = order[o];
+    size_t from = starts[b];
+    size_t to = starts[b + 1];
+    fz->pilots[b] = 0;
+    if (from == to) {
+      continue;
+    }
+    built = 0;
+    for (size_t pilot = 0; pilot < RHMAPPER_FROZEN_PILOTS && !built;
+         pilot++) {
+      size_t i = from;
+      for (; i < to; i++) {
+        size_t position = rhmapper_frozen_internal_position(
+            hashes[members[i]], pilot, m);
+        uint64_t bit = (uint64_t)1 << position % 64;
+        if (taken[position / 64] & bit) {
+          break;
+        }
+        taken[position / 64] |= bit;
+        fz->ids[position] = (uint32_t)members[i];
+      }
+      if (i == to) {
+        fz->pilots[b] = pilot;
+        built = 1;
+      } else {
+        while (i-- > from) {
+          size_t position = rhmapper_frozen_internal_position(
+              hashes[members[i]], pilot, m);
+          taken[position / 64] &= ~((uint64_t)1 << position % 64);
+        }
+      }
+    }
+  }
+
+  free(starts);
+  free(members);
+  free(order);
+  free(taken);
+  return built;
+}
+
+rhmapper_frozen_t *rhmapper_freeze(rhmapper_t *rh) {
+#ifdef RHMAPPER_INCREMENTAL
+  if (rh->old != NULL) {
+    rhmapper_internal_step(rh, rh->old->capacity);
+  }
+#endif
+  rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+  size_t n = rh->size;
+  rhmapper_frozen_t *fz = rhmapper_calloc(1, sizeof(rhmapper_frozen_t));
+  fz->size = n;
+  fz->buckets = n / RHMAPPER_FROZEN_BUCKET + 1;
+  fz->seed = 0;
+  fz->pilots = rhmapper_malloc(fz->buckets * sizeof(uint16_t));
+  fz->slots = n + n / RHMAPPER_FROZEN_SLACK + 1;
+  fz->ids = rhmapper_calloc(fz->slots, sizeof(uint32_t));
+  fz->offsets = rhmapper_calloc(n + 1, sizeof(uint32_t));
+
+  size_t length = 0;
+  for (size_t i = 0; i < table->capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      fz->offsets[it.value + 1] = it.size;
+      length += it.size;
+    }
+  }
+  assert(fz->slots < UINT32_MAX && length < UINT32_MAX);
+  for (size_t i = 0; i < n; i++) {
+    fz->offsets[i + 1] += fz->offsets[i];
+  }
+  fz->data = rhmapper_malloc(fz->offsets[n] + 1);
+  for (size_t i = 0; i < table->capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      memcpy(fz->data + fz->offsets[it.value], RHMAPPER_KEY(table, it),
+             it.size);
+    }
+  }
+
+  uint64_t *hashes = rhmapper_malloc((n + 1) * sizeof(uint64_t));
+  while (!rhmapper_frozen_internal_build(fz, hashes)) {
+    fz->seed++;
+  }
+  free(hashes);
+  return fz;
+}
+
+void rhmapper_frozen_destroy(rhmapper_frozen_t *fz) {
+  free(fz->pilots);
+  free(fz->ids);
+  free(fz->offsets);
+  free(fz->data);
+  free(fz);
+}
+
+size_t rhmapper_frozen_get(rhmapper_frozen_t *fz, char *key, size_t size) {
+  if (fz->size == 0) {
+    return RHMAPPER_EMPTY_VALUE;
+  }
+  uint64_t hash = rhmapper_frozen_internal_hash(fz, key, size);
+  uint16_t pilot =
+      fz->pilots[rhmapper_frozen_internal_reduce(hash, fz->buckets)];
+  size_t id = fz->ids[rhmapper_frozen_internal_position(
+      hash, pilot, fz->slots)];
+  size_t from = fz->offsets[id];
+  if (fz->offsets[id + 1] - from == size &&
+      !memcmp(key, fz->data + from, size)) {
+    return id;
+  }
+  return RHMAPPER_EMPTY_VALUE;
+}
+
+rhmapper_string_t rhmapper_frozen_rev(rhmapper_frozen_t *fz, size_t index) {
+  rhmapper_string_t key = {
+      .size = fz->offsets[index + 1] - fz->offsets[index],
+      .data = fz->data + fz->offsets[index],
+  };
+  return key;
+}
+
+#endif
@@ -0,0 +1,154 @@
+#if defined(RHMAPPER_COMPACT) || defined(RHMAPPER_MODULO) || \
+    defined(RHMAPPER_HASH)
+#error "rhmapper_gen emits power-of-two tables hashed with XXH3"
+#endif
+
+#include "rhmapper.h"
+
+char *rhmapper_gen_read(FILE *file, size_t *size) {
+  size_t capacity = 1 << 16;
+  char *data = rhmapper_malloc(capacity);
+  *size = 0;
+  size_t n;
+  while ((n = fread(data + *size, 1, capacity - *size, file)) > 0) {
+    *size += n;
+    if (*size == capacity) {
+      capacity *= RHMAPPER_GROW_FACTOR;
+      data = realloc(data, capacity);
+      assert(data);
+    }
+  }
+  return data;
+}
+
+void rhmapper_gen_bytes(FILE *out, const char *data, size_t size) {
+  for (size_t i = 0; i <= size; i++) {
+    fputs(i % 8 == 0 ? "\n    " : " ", out);
+    fprintf(out, "'\\x%02x',", i < size ? (uint8_t)data[i] : 0);
+  }
+  fputs("\n", out);
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s prefix < keys > prefix.h\n", argv[0]);
+    return 1;
+  }
+  const char *prefix = argv[1];
+  size_t length;
+  char *input = rhmapper_gen_read(stdin, &length);
+  size_t n = 0;
+  for (size_t i = 0; i < length; i++) {
+    n += input[i] == '\n';
+  }
+  n += length > 0 && input[length - 1] != '\n';
+  char **keys = rhmapper_malloc((n + 1) * sizeof(char *));
+  size_t *sizes = rhmapper_malloc((n + 1) * sizeof(size_t));
+  for (size_t i = 0, start = 0; i < n; i++) {
+    size_t end = start;
+    while (end < length && input[end] != '\n') {
+      end++;
+    }
+    keys[i] = input + start;
+    sizes[i] = end - start;
+    start = end + 1;
+  }
+
+  rhmapper_t *rh = rhmapper_build(keys, sizes, n);
+  rhmapper_table_t *table = RHMAPPER_LOAD(rh->table);
+  assert(rh->size < UINT32_MAX);
+  size_t *offsets = rhmapper_calloc(rh->size + 1, sizeof(size_t));
+  for (size_t i = 0; i < table->capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      offsets[it.value + 1] = it.size;
+    }
+  }
+  for (size_t i = 0; i < rh->size; i++) {
+    offsets[i + 1] += offsets[i];
+  }
+  assert(offsets[rh->size] < UINT32_MAX);
+  char *data = rhmapper_malloc(offsets[rh->size] + 1);
+  for (size_t i = 0; i < table->capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      memcpy(data + offsets[it.value], RHMAPPER_KEY(table, it), it.size);
+    }
+  }
+
+  FILE *out = stdout;
+  fprintf(out, "#ifndef RHMAPPER_GEN_%s_H\n", prefix);
+  fprintf(out, "#define RHMAPPER_GEN_%s_H\n\n", prefix);
+  fputs("#include <stddef.h>\n#include <stdint.h>\n#include <string.h>\n\n",
+        out);
+  fputs("#define XXH_INLINE_ALL\n#include \"xxhash.h\"\n\n", out);
+  fprintf(out, "#define %s_SIZE %zu\n", prefix, rh->size);
+  fprintf(out, "#define %s_CAPACITY %zu\n\n", prefix, table->capacity);
+  fprintf(out, "typedef struct %s_slot %s_slot_t;\n", prefix, prefix);
+  fprintf(out, "typedef struct %s_string %s_string_t;\n\n", prefix, prefix);
+  fprintf(out, "struct %s_slot {\n  uint64_t hash;\n  uint32_t value;\n"
+               "  uint32_t psl;\n};\n\n", prefix);
+  fprintf(out, "struct %s_string {\n  size_t size;\n  const char *data;\n"
+               "};\n\n", prefix);
+
+  fprintf(out, "static const %s_slot_t %s_slots[%zu] = {\n", prefix, prefix,
+          table->capacity);
+  for (size_t i = 0; i < table->capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    fprintf(out, "    {0x%016llxull, %zu, %u},\n",
+            (unsigned long long)(it.psl != 0 ? it.hash : 0),
+            it.psl != 0 ? (size_t)it.value : 0, (unsigned)it.psl);
+  }
+  fputs("};\n\n", out);
+
+  fprintf(out, "static const uint32_t %s_offsets[%zu] = {\n", prefix,
+          rh->size + 1);
+  for (size_t i = 0; i <= rh->size; i++) {
+    fprintf(out, "    %zu,\n", offsets[i]);
+  }
+  fputs("};\n\n", out);
+
+  fprintf(out, "static const char %s_keys[%zu] = {", prefix,
+          offsets[rh->size] + 1);
+  rhmapper_gen_bytes(out, data, offsets[rh->size]);
+  fputs("};\n\n", out);
+
+  fprintf(out,
+          "static inline size_t %s_get(const char *key, size_t size) {\n"
+          "  uint64_t hash = XXH3_64bits(key, size);\n"
+          "  size_t index = hash & (%s_CAPACITY - 1);\n"
+          "  for (uint32_t psl = 1;; psl++) {\n"
+          "    const %s_slot_t *it = &%s_slots[index];\n"
+          "    if (it->psl < psl) {\n"
+          "      return (size_t)-1;\n"
+          "    }\n"
+          "    if (it->hash == hash) {\n"
+          "      uint32_t from = %s_offsets[it->value];\n"
+          "      if (%s_offsets[it->value + 1] - from == size &&\n"
+          "          !memcmp(key, %s_keys + from, size)) {\n"
+          "        return it->value;\n"
+          "      }\n"
+          "    }\n"
+          "    index = (index + 1) & (%s_CAPACITY - 1);\n"
+          "  }\n"
+          "}\n\n",
+          prefix, prefix, prefix, prefix, prefix, prefix, prefix, prefix);
+  fprintf(out,
+          "static inline %s_string_t %s_rev(size_t index) {\n"
+          "  %s_string_t key = {\n"
+          "      .size = %s_offsets[index + 1] - %s_offsets[index],\n"
+          "      .data = %s_keys + %s_offsets[index],\n"
+          "  };\n"
+          "  return key;\n"
+          "}\n\n",
+          prefix, prefix, prefix, prefix, prefix, prefix, prefix);
+  fputs("#endif\n", out);
+
+  free(data);
+  free(offsets);
+  rhmapper_destroy(rh);
+  free(keys);
+  free(sizes);
+  free(input);
+  return ferror(out) ? 1 : 0;
+}
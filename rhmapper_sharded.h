@@ -0,0 +1,139 @@
+#ifndef BBTEX_RHMAPPER_SHARDED_H
+#define BBTEX_RHMAPPER_SHARDED_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "rhmapper.h"
+
+#ifdef RHMAPPER_COMPACT
+#error "rhmapper_sharded.h needs stable key pointers and cannot be used with RHMAPPER_COMPACT"
+#endif
+
+#define RHMAPPER_SHARDED_SEGMENT 10
+#define RHMAPPER_SHARDED_SEGMENTS \
+  (sizeof(size_t) * 8 - RHMAPPER_SHARDED_SEGMENT)
+#define RHMAPPER_SHARDED_SHARD(hash, count) \
+  (((hash) >> (sizeof(size_t) * 4)) & ((count) - 1))
+
+typedef struct rhmapper_sharded rhmapper_sharded_t;
+typedef struct rhmapper_shard rhmapper_shard_t;
+
+struct rhmapper_shard {
+  pthread_mutex_t lock;
+  rhmapper_t *rh;
+  char padding[64];
+};
+
+struct rhmapper_sharded {
+  size_t count;
+  rhmapper_shard_t *shards;
+  atomic_size_t size;
+  _Atomic(rhmapper_string_t *) reverse[RHMAPPER_SHARDED_SEGMENTS];
+};
+
+rhmapper_sharded_t *rhmapper_sharded_create(size_t count, size_t capacity) {
+  assert(count >= 1);
+  count = rhmapper_internal_pow2(count);
+  capacity = capacity / count + 1;
+
+  rhmapper_sharded_t *sh;
+  sh = rhmapper_calloc(1, sizeof(rhmapper_sharded_t));
+  sh->count = count;
+  sh->shards = rhmapper_calloc(count, sizeof(rhmapper_shard_t));
+  for (size_t i = 0; i < count; i++) {
+    pthread_mutex_init(&sh->shards[i].lock, NULL);
+    sh->shards[i].rh = rhmapper_create(capacity);
+  }
+  atomic_init(&sh->size, 0);
+  for (size_t i = 0; i < RHMAPPER_SHARDED_SEGMENTS; i++) {
+    atomic_init(&sh->reverse[i], NULL);
+  }
+
+  return sh;
+}
+
+void rhmapper_sharded_destroy(rhmapper_sharded_t *sh) {
+  for (size_t i = 0; i < sh->count; i++) {
+    pthread_mutex_destroy(&sh->shards[i].lock);
+    rhmapper_destroy(sh->shards[i].rh);
+  }
+  for (size_t i = 0; i < RHMAPPER_SHARDED_SEGMENTS; i++) {
+    free(atomic_load(&sh->reverse[i]));
+  }
+  free(sh->shards);
+  free(sh);
+}
+
+rhmapper_string_t *rhmapper_sharded_slot(
+    rhmapper_sharded_t *sh, size_t index) {
+  size_t biased = index + ((size_t)1 << RHMAPPER_SHARDED_SEGMENT);
+#ifdef __GNUC__
+  size_t bit = 63 - __builtin_clzll(biased);
+#else
+  size_t bit = sizeof(size_t) * 8 - 1;
+  while (!(biased >> bit)) {
+    bit--;
+  }
+#endif
+  size_t segment = bit - RHMAPPER_SHARDED_SEGMENT;
+  rhmapper_string_t *reverse =
+      atomic_load_explicit(&sh->reverse[segment], memory_order_acquire);
+  if (reverse == NULL) {
+    rhmapper_string_t *fresh =
+        rhmapper_calloc((size_t)1 << bit, sizeof(rhmapper_string_t));
+    if (atomic_compare_exchange_strong(
+            &sh->reverse[segment], &reverse, fresh)) {
+      reverse = fresh;
+    } else {
+      free(fresh);
+    }
+  }
+  return reverse + (biased - ((size_t)1 << bit));
+}
+
+size_t rhmapper_sharded_put_hashed(
+    rhmapper_sharded_t *sh, char *key, size_t size, size_t hash) {
+  rhmapper_shard_t *shard =
+      &sh->shards[RHMAPPER_SHARDED_SHARD(hash, sh->count)];
+  pthread_mutex_lock(&shard->lock);
+  size_t value = rhmapper_internal_get(shard->rh, key, size, hash);
+  if (value == (size_t)RHMAPPER_EMPTY_VALUE) {
+    value = atomic_fetch_add(&sh->size, 1);
+    rhmapper_kv_t kv = rhmapper_internal_entry(
+        shard->rh, key, size, hash, value, rhmapper_sharded_slot(sh, value));
+    rhmapper_internal_publish(shard->rh, kv);
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return value;
+}
+
+size_t rhmapper_sharded_put(rhmapper_sharded_t *sh, char *key, size_t size) {
+  return rhmapper_sharded_put_hashed(sh, key, size, RHMAPPER_HASH(key, size));
+}
+
+size_t rhmapper_sharded_get_hashed(
+    rhmapper_sharded_t *sh, char *key, size_t size, size_t hash) {
+  rhmapper_shard_t *shard =
+      &sh->shards[RHMAPPER_SHARDED_SHARD(hash, sh->count)];
+#ifdef RHMAPPER_CONCURRENT
+  size_t epoch = rhmapper_internal_enter(shard->rh);
+  size_t value = rhmapper_internal_get(shard->rh, key, size, hash);
+  rhmapper_internal_exit(shard->rh, epoch);
+#else
+  pthread_mutex_lock(&shard->lock);
+  size_t value = rhmapper_internal_get(shard->rh, key, size, hash);
+  pthread_mutex_unlock(&shard->lock);
+#endif
+  return value;
+}
+
+size_t rhmapper_sharded_get(rhmapper_sharded_t *sh, char *key, size_t size) {
+  return rhmapper_sharded_get_hashed(sh, key, size, RHMAPPER_HASH(key, size));
+}
+
+rhmapper_string_t rhmapper_sharded_rev(rhmapper_sharded_t *sh, size_t index) {
+  return *rhmapper_sharded_slot(sh, index);
+}
+
+#endif
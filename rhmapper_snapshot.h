@@ -0,0 +1,245 @@
+#ifndef BBTEX_RHMAPPER_SNAPSHOT_H
+#define BBTEX_RHMAPPER_SNAPSHOT_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "rhmapper.h"
+
+#define RHMAPPER_SNAPSHOT_MAGIC "rhmapper"
+#define RHMAPPER_SNAPSHOT_ALIGN(offset) (((offset) + 7) & ~(uint64_t)7)
+#ifdef RHMAPPER_SIMD
+#define RHMAPPER_SNAPSHOT_TAGS(capacity) ((capacity) + RHMAPPER_GROUP - 1)
+#define RHMAPPER_SNAPSHOT_GROUP RHMAPPER_GROUP
+#else
+#define RHMAPPER_SNAPSHOT_TAGS(capacity) 0
+#define RHMAPPER_SNAPSHOT_GROUP 0
+#endif
+#ifdef RHMAPPER_MODULO
+#define RHMAPPER_SNAPSHOT_MODULO 1
+#else
+#define RHMAPPER_SNAPSHOT_MODULO 0
+#endif
+#ifdef RHMAPPER_REVERSE
+#define RHMAPPER_SNAPSHOT_REVERSE 1
+#else
+#define RHMAPPER_SNAPSHOT_REVERSE 0
+#endif
+#ifdef RHMAPPER_FILTER
+#define RHMAPPER_SNAPSHOT_FILTER RHMAPPER_FILTER_BITS
+#define RHMAPPER_SNAPSHOT_FILTER_BYTES(capacity)                       \
+  (rhmapper_internal_filter_blocks(capacity) * RHMAPPER_FILTER_WORDS * \
+   sizeof(uint64_t))
+#define RHMAPPER_SNAPSHOT_FILTER_OFFSET(offset) \
+  (((offset) + 63) & ~(uint64_t)63)
+#else
+#define RHMAPPER_SNAPSHOT_FILTER 0
+#endif
+#define RHMAPPER_SNAPSHOT_LAYOUT                                       \
+  (sizeof(rhmapper_kv_t) | RHMAPPER_SNAPSHOT_GROUP << 8 |              \
+   RHMAPPER_SNAPSHOT_MODULO << 16 | RHMAPPER_SNAPSHOT_REVERSE << 17 |  \
+   sizeof(size_t) << 24 | (uint64_t)RHMAPPER_INLINE_SIZE << 32 |       \
+   (uint64_t)RHMAPPER_SNAPSHOT_FILTER << 40)
+
+typedef struct rhmapper_snapshot rhmapper_snapshot_t;
+
+struct rhmapper_snapshot {
+  char magic[8];
+  uint64_t layout;
+  uint64_t hash;
+  uint64_t size;
+  uint64_t capacity;
+  uint64_t keys;
+  uint64_t reverse;
+  uint64_t length;
+};
+
+int rhmapper_save(rhmapper_t *rh, const char *path) {
+#ifdef RHMAPPER_INCREMENTAL
+  if (rh->old != NULL) {
+    rhmapper_internal_step(rh, rh->old->capacity);
+  }
+#endif
+  rhmapper_table_t *table = rh->table;
+  size_t capacity = table->capacity;
+  uint64_t bytes = 0;
+  for (size_t i = 0; i < capacity; i++) {
+    bytes += table->array[i].size;
+  }
+
+  rhmapper_snapshot_t header = {
+      .magic = RHMAPPER_SNAPSHOT_MAGIC,
+      .layout = RHMAPPER_SNAPSHOT_LAYOUT,
+      .hash = RHMAPPER_HASH(RHMAPPER_SNAPSHOT_MAGIC, 8),
+      .size = rh->size,
+      .capacity = capacity,
+  };
+  header.keys = RHMAPPER_SNAPSHOT_ALIGN(
+      sizeof(header) + capacity * sizeof(rhmapper_kv_t) +
+      RHMAPPER_SNAPSHOT_TAGS(capacity));
+#ifdef RHMAPPER_FILTER
+  uint64_t filter = RHMAPPER_SNAPSHOT_FILTER_OFFSET(header.keys + bytes);
+  header.reverse = filter + RHMAPPER_SNAPSHOT_FILTER_BYTES(capacity);
+#else
+  header.reverse = RHMAPPER_SNAPSHOT_ALIGN(header.keys + bytes);
+#endif
+  assert(header.reverse <= (rhmapper_ref_t)-1);
+  header.length = header.reverse;
+#ifdef RHMAPPER_REVERSE
+  header.length += rh->size * sizeof(rhmapper_string_t);
+#endif
+
+  FILE *file = fopen(path, "wb");
+  if (file == NULL) {
+    return -1;
+  }
+#ifdef RHMAPPER_REVERSE
+  uint64_t *offsets = rhmapper_calloc(rh->size + 1, sizeof(uint64_t));
+#endif
+  fwrite(&header, sizeof(header), 1, file);
+  uint64_t offset = header.keys;
+  for (size_t i = 0; i < capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      if (!RHMAPPER_INLINE(it.size)) {
+        it.data = offset;
+      }
+#ifdef RHMAPPER_REVERSE
+      offsets[it.value] = offset;
+#endif
+      offset += it.size;
+    }
+    fwrite(&it, sizeof(it), 1, file);
+  }
+#ifdef RHMAPPER_SIMD
+  fwrite(table->tags, 1, RHMAPPER_SNAPSHOT_TAGS(capacity), file);
+#endif
+  for (uint64_t i = sizeof(header) + capacity * sizeof(rhmapper_kv_t) +
+                    RHMAPPER_SNAPSHOT_TAGS(capacity);
+       i < header.keys; i++) {
+    fputc(0, file);
+  }
+  for (size_t i = 0; i < capacity; i++) {
+    rhmapper_kv_t it = table->array[i];
+    if (it.psl != 0) {
+      fwrite(RHMAPPER_KEY(table, it), 1, it.size, file);
+    }
+  }
+#ifdef RHMAPPER_FILTER
+  for (uint64_t i = header.keys + bytes; i < filter; i++) {
+    fputc(0, file);
+  }
+  fwrite(RHMAPPER_FILTER_BLOCK(rh->filter, (uint64_t)0), 1,
+         RHMAPPER_SNAPSHOT_FILTER_BYTES(capacity), file);
+#else
+  for (uint64_t i = header.keys + bytes; i < header.reverse; i++) {
+    fputc(0, file);
+  }
+#endif
+#ifdef RHMAPPER_REVERSE
+  for (size_t i = 0; i < rh->size; i++) {
+    rhmapper_string_t it = {
+        .size = rh->reverse[i].size,
+        .data = (char *)(uintptr_t)offsets[i],
+    };
+    fwrite(&it, sizeof(it), 1, file);
+  }
+  free(offsets);
+#endif
+  int failed = ferror(file);
+  return fclose(file) || failed ? -1 : 0;
+}
+
+int rhmapper_snapshot_valid(rhmapper_snapshot_t *header, uint64_t length) {
+  uint64_t capacity = header->capacity;
+  if (memcmp(header->magic, RHMAPPER_SNAPSHOT_MAGIC, 8) ||
+      header->layout != RHMAPPER_SNAPSHOT_LAYOUT ||
+      header->hash != RHMAPPER_HASH(RHMAPPER_SNAPSHOT_MAGIC, 8) ||
+      header->length != length || capacity == 0 ||
+      capacity > (length - sizeof(*header)) / sizeof(rhmapper_kv_t) ||
+      header->size > capacity) {
+    return 0;
+  }
+#ifndef RHMAPPER_MODULO
+  if (capacity & (capacity - 1)) {
+    return 0;
+  }
+#endif
+  uint64_t slots = sizeof(*header) + capacity * sizeof(rhmapper_kv_t) +
+                   RHMAPPER_SNAPSHOT_TAGS(capacity);
+  if (slots > header->keys || header->keys > header->reverse ||
+      header->reverse > length) {
+    return 0;
+  }
+#ifdef RHMAPPER_FILTER
+  uint64_t bytes = RHMAPPER_SNAPSHOT_FILTER_BYTES(capacity);
+  if (header->reverse - header->keys < bytes ||
+      (header->reverse - bytes) % 64 != 0) {
+    return 0;
+  }
+#endif
+#ifdef RHMAPPER_REVERSE
+  return (length - header->reverse) / sizeof(rhmapper_string_t) ==
+             header->size &&
+         (length - header->reverse) % sizeof(rhmapper_string_t) == 0;
+#else
+  return header->reverse == length;
+#endif
+}
+
+rhmapper_t *rhmapper_open_mmap(const char *path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) || (size_t)st.st_size < sizeof(rhmapper_snapshot_t)) {
+    close(fd);
+    return NULL;
+  }
+  char *base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    return NULL;
+  }
+  rhmapper_snapshot_t *header = (rhmapper_snapshot_t *)base;
+  if (!rhmapper_snapshot_valid(header, st.st_size)) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+
+  rhmapper_table_t *table = rhmapper_calloc(1, sizeof(rhmapper_table_t));
+  table->capacity = header->capacity;
+  table->base = (uintptr_t)base;
+  table->array = (rhmapper_kv_t *)(base + sizeof(rhmapper_snapshot_t));
+#ifdef RHMAPPER_SIMD
+  table->tags = (uint8_t *)(table->array + table->capacity);
+#endif
+  rhmapper_t *rh = rhmapper_internal_create(table);
+  rh->size = header->size;
+#ifdef RHMAPPER_REVERSE
+  rh->reverse = (rhmapper_string_t *)(base + header->reverse);
+#endif
+#ifdef RHMAPPER_FILTER
+  uint64_t filter =
+      header->reverse - RHMAPPER_SNAPSHOT_FILTER_BYTES(table->capacity);
+  rh->filter.data = (uint64_t *)(base + filter);
+  rh->filter.mask = rhmapper_internal_filter_blocks(table->capacity) - 1;
+#endif
+  return rh;
+}
+
+void rhmapper_close_mmap(rhmapper_t *rh) {
+  rhmapper_table_t *table = rh->table;
+  rhmapper_snapshot_t *header = (rhmapper_snapshot_t *)table->base;
+  munmap((void *)table->base, header->length);
+#ifdef RHMAPPER_CACHE
+  free(rh->cache);
+#endif
+  free(table);
+  free(rh);
+}
+
+#endif
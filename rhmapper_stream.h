@@ -0,0 +1,146 @@
+#ifndef BBTEX_RHMAPPER_STREAM_H
+#define BBTEX_RHMAPPER_STREAM_H
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "rhmapper.h"
+
+#define RHMAPPER_STREAM_BUFFER (1 << 20)
+#define RHMAPPER_STREAM_BATCH 256
+#ifdef RHMAPPER_SIMD
+#define RHMAPPER_STREAM_PADDING RHMAPPER_GROUP
+#else
+#define RHMAPPER_STREAM_PADDING 0
+#endif
+
+typedef struct rhmapper_stream rhmapper_stream_t;
+
+struct rhmapper_stream {
+  rhmapper_t *rh;
+  int fd;
+  int eof;
+  int error;
+  char *delimiters;
+  uint8_t table[256];
+  char *buffer;
+  size_t capacity;
+  size_t start;
+  size_t end;
+  size_t count;
+  char *keys[RHMAPPER_STREAM_BATCH];
+  size_t sizes[RHMAPPER_STREAM_BATCH];
+};
+
+rhmapper_stream_t *rhmapper_stream_create(
+    rhmapper_t *rh, int fd, const char *delimiters) {
+  rhmapper_stream_t *stream = rhmapper_calloc(1, sizeof(rhmapper_stream_t));
+  stream->rh = rh;
+  stream->fd = fd;
+  stream->eof = 0;
+  stream->error = 0;
+  size_t size = strlen(delimiters) + 1;
+  stream->delimiters = rhmapper_malloc(size);
+  memcpy(stream->delimiters, delimiters, size);
+  for (const char *it = delimiters; *it; it++) {
+    stream->table[(uint8_t)*it] = 1;
+  }
+  stream->capacity = RHMAPPER_STREAM_BUFFER;
+  stream->buffer =
+      rhmapper_malloc(stream->capacity + RHMAPPER_STREAM_PADDING);
+  stream->start = 0;
+  stream->end = 0;
+  stream->count = 0;
+  return stream;
+}
+
+void rhmapper_stream_destroy(rhmapper_stream_t *stream) {
+  free(stream->delimiters);
+  free(stream->buffer);
+  free(stream);
+}
+
+#ifdef RHMAPPER_SIMD
+size_t rhmapper_stream_internal_scan(
+    rhmapper_stream_t *stream, size_t from, size_t to) {
+  for (size_t i = from; i < to; i += RHMAPPER_GROUP) {
+    const uint8_t *group = (const uint8_t *)stream->buffer + i;
+    rhmapper_mask_t mask = 0;
+    for (const char *it = stream->delimiters; *it; it++) {
+      mask |= rhmapper_internal_match(group, (uint8_t)*it);
+    }
+    if (mask) {
+      size_t at = i + rhmapper_internal_ctz(mask) / RHMAPPER_STRIDE;
+      return at < to ? at : to;
+    }
+  }
+  return to;
+}
+#else
+size_t rhmapper_stream_internal_scan(
+    rhmapper_stream_t *stream, size_t from, size_t to) {
+  while (from < to && !stream->table[(uint8_t)stream->buffer[from]]) {
+    from++;
+  }
+  return from;
+}
+#endif
+
+void rhmapper_stream_internal_fill(rhmapper_stream_t *stream) {
+  size_t remaining = stream->end - stream->start;
+  memmove(stream->buffer, stream->buffer + stream->start, remaining);
+  stream->start = 0;
+  stream->end = remaining;
+  if (stream->end == stream->capacity) {
+    stream->capacity *= RHMAPPER_GROW_FACTOR;
+    stream->buffer =
+        realloc(stream->buffer, stream->capacity + RHMAPPER_STREAM_PADDING);
+    assert(stream->buffer);
+  }
+  ssize_t n;
+  do {
+    n = read(stream->fd, stream->buffer + stream->end,
+             stream->capacity - stream->end);
+  } while (n < 0 && errno == EINTR);
+  if (n <= 0) {
+    stream->eof = 1;
+    stream->error = n < 0 ? errno : 0;
+  } else {
+    stream->end += n;
+  }
+}
+
+size_t rhmapper_stream_internal_flush(rhmapper_stream_t *stream, size_t *ids) {
+  size_t count = stream->count;
+  rhmapper_put_many(stream->rh, stream->keys, stream->sizes, count, ids);
+  stream->count = 0;
+  return count;
+}
+
+size_t rhmapper_stream_read(rhmapper_stream_t *stream, size_t *ids, size_t n) {
+  size_t written = 0;
+  while (written + stream->count < n) {
+    size_t at =
+        rhmapper_stream_internal_scan(stream, stream->start, stream->end);
+    if (at == stream->end && !stream->eof) {
+      written += rhmapper_stream_internal_flush(stream, ids + written);
+      rhmapper_stream_internal_fill(stream);
+      continue;
+    } else if (at == stream->end && stream->start == stream->end) {
+      break;
+    }
+    if (at > stream->start) {
+      stream->keys[stream->count] = stream->buffer + stream->start;
+      stream->sizes[stream->count] = at - stream->start;
+      stream->count++;
+    }
+    stream->start = at == stream->end ? at : at + 1;
+    if (stream->count == RHMAPPER_STREAM_BATCH) {
+      written += rhmapper_stream_internal_flush(stream, ids + written);
+    }
+  }
+  written += rhmapper_stream_internal_flush(stream, ids + written);
+  return written;
+}
+
+#endif
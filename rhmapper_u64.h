@@ -0,0 +1,18 @@
+#ifndef BBTEX_RHMAPPER_U64_H
+#define BBTEX_RHMAPPER_U64_H
+
+#include "rhmapper_define.h"
+
+size_t rhmapper_hash_u64(uint64_t key) {
+  uint64_t hash = key * 0x9E3779B97F4A7C15ull;
+  return hash ^ hash >> 32;
+}
+
+int rhmapper_eq_u64(uint64_t a, uint64_t b) {
+  return a == b;
+}
+
+RHMAPPER_DEFINE(rhmapper_u64, uint64_t, rhmapper_hash_u64, rhmapper_eq_u64,
+                size_t)
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef RHMAPPER_CONCURRENT
+#define RHMAPPER_CONCURRENT
+#endif
+
+#include <pthread.h>
+
+#include "rhmapper.h"
+
+#define TEST_KEYS 2000000
+#define TEST_READERS 3
+
+rhmapper_t *test_rh;
+atomic_size_t test_published;
+atomic_int test_done;
+
+size_t test_key(size_t i, char *buffer) {
+  return snprintf(buffer, 32, "key-%zu-%zu", i, i * 7 % 13);
+}
+
+void test_fail(const char *what, size_t i, size_t value) {
+  fprintf(stderr, "%s: key %zu got %zu\n", what, i, value);
+  exit(1);
+}
+
+void *test_reader(void *arg) {
+  uint64_t seed = (uintptr_t)arg * 2654435761u + 1;
+  size_t checks = 0;
+  char buffer[32];
+  while (!atomic_load(&test_done)) {
+    size_t published = atomic_load(&test_published);
+    if (published == 0) {
+      continue;
+    }
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    size_t i = (seed >> 33) % published;
+    size_t size = test_key(i, buffer);
+    size_t value = rhmapper_get(test_rh, buffer, size);
+    if (value != i) {
+      test_fail("get", i, value);
+    }
+#ifdef RHMAPPER_REVERSE
+    rhmapper_string_t key = rhmapper_rev(test_rh, i);
+    if (key.size != size || memcmp(key.data, buffer, size)) {
+      test_fail("rev", i, key.size);
+    }
+#endif
+    size = test_key(i + TEST_KEYS, buffer);
+    value = rhmapper_get(test_rh, buffer, size);
+    if (value != (size_t)RHMAPPER_EMPTY_VALUE) {
+      test_fail("miss", i + TEST_KEYS, value);
+    }
+    checks++;
+  }
+  return (void *)checks;
+}
+
+int main(void) {
+  test_rh = rhmapper_create(1);
+  pthread_t readers[TEST_READERS];
+  for (uintptr_t i = 0; i < TEST_READERS; i++) {
+    pthread_create(&readers[i], NULL, test_reader, (void *)i);
+  }
+  char buffer[32];
+  for (size_t i = 0; i < TEST_KEYS; i++) {
+    size_t size = test_key(i, buffer);
+    size_t value = rhmapper_put(test_rh, buffer, size);
+    if (value != i) {
+      test_fail("put", i, value);
+    }
+    atomic_store(&test_published, i + 1);
+  }
+  atomic_store(&test_done, 1);
+  size_t checks = 0;
+  for (size_t i = 0; i < TEST_READERS; i++) {
+    void *result;
+    pthread_join(readers[i], &result);
+    checks += (size_t)result;
+  }
+  rhmapper_destroy(test_rh);
+  printf("ok, %zu reader checks\n", checks);
+  return 0;
+}
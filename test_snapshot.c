@@ -0,0 +1,127 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include "rhmapper_snapshot.h"
+
+#define TEST_KEYS 100000
+#define TEST_PATH "test_snapshot.rhm"
+#define TEST_BAD_PATH "test_snapshot_bad.rhm"
+
+char *test_file;
+size_t test_length;
+
+size_t test_key(size_t i, char *buffer) {
+  return snprintf(buffer, 32, i % 3 ? "key-%zu" : "k%zu", i);
+}
+
+void test_fail(const char *what, size_t i, size_t value) {
+  fprintf(stderr, "%s: %zu got %zu\n", what, i, value);
+  exit(1);
+}
+
+void test_round_trip(size_t n) {
+  char buffer[32];
+  rhmapper_t *rh = rhmapper_create(1);
+  for (size_t i = 0; i < n; i++) {
+    rhmapper_put(rh, buffer, test_key(i, buffer));
+  }
+  if (rhmapper_save(rh, TEST_PATH)) {
+    test_fail("save", n, 0);
+  }
+  rhmapper_t *mapped = rhmapper_open_mmap(TEST_PATH);
+  if (mapped == NULL || mapped->size != n) {
+    test_fail("open", n, mapped == NULL ? 0 : mapped->size);
+  }
+  for (size_t i = 0; i < n; i++) {
+    size_t size = test_key(i, buffer);
+    size_t value = rhmapper_get(mapped, buffer, size);
+    if (value != i) {
+      test_fail("get", i, value);
+    }
+#ifdef RHMAPPER_REVERSE
+    rhmapper_string_t key = rhmapper_rev(mapped, i);
+    if (key.size != size || memcmp(key.data, buffer, size)) {
+      test_fail("rev", i, key.size);
+    }
+#endif
+    size = test_key(i + n, buffer);
+    value = rhmapper_get(mapped, buffer, size);
+    if (value != (size_t)RHMAPPER_EMPTY_VALUE) {
+      test_fail("miss", i + n, value);
+    }
+  }
+  rhmapper_close_mmap(mapped);
+  rhmapper_destroy(rh);
+}
+
+void test_load(void) {
+  FILE *file = fopen(TEST_PATH, "rb");
+  fseek(file, 0, SEEK_END);
+  test_length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  test_file = rhmapper_malloc(test_length);
+  if (fread(test_file, 1, test_length, file) != test_length) {
+    test_fail("read", test_length, 0);
+  }
+  fclose(file);
+}
+
+void test_reject(const char *what, size_t field, uint64_t value,
+                 size_t length) {
+  rhmapper_snapshot_t header;
+  memcpy(&header, test_file, sizeof(header));
+  uint64_t *fields = (uint64_t *)&header;
+  fields[field] = value;
+  FILE *file = fopen(TEST_BAD_PATH, "wb");
+  fwrite(&header, 1, length < sizeof(header) ? length : sizeof(header), file);
+  if (length > sizeof(header)) {
+    fwrite(test_file + sizeof(header), 1, length - sizeof(header), file);
+  }
+  fclose(file);
+  rhmapper_t *mapped = rhmapper_open_mmap(TEST_BAD_PATH);
+  if (mapped != NULL) {
+    fprintf(stderr, "accepted %s\n", what);
+    exit(1);
+  }
+}
+
+int main(void) {
+  test_round_trip(0);
+  test_round_trip(1);
+  test_round_trip(TEST_KEYS);
+
+  test_load();
+  rhmapper_snapshot_t *header = (rhmapper_snapshot_t *)test_file;
+  size_t length = test_length;
+  test_reject("magic", 0, 0, length);
+  test_reject("layout", 1, header->layout ^ 1, length);
+  test_reject("hash", 2, header->hash + 1, length);
+  test_reject("size above capacity", 3, header->capacity + 1, length);
+  test_reject("zero capacity", 4, 0, length);
+  test_reject("huge capacity", 4, (uint64_t)1 << 62, length);
+  test_reject("capacity past keys", 4, header->capacity * 2, length);
+#ifndef RHMAPPER_MODULO
+  test_reject("capacity not a power of two", 4, header->capacity - 1,
+              length);
+#endif
+  test_reject("keys inside slots", 5, sizeof(rhmapper_snapshot_t), length);
+  test_reject("keys past reverse", 5, header->reverse + 8, length);
+  test_reject("reverse past length", 6, length + 8, length);
+  test_reject("length", 7, length + 1, length);
+  test_reject("truncated", 7, length - 1, length - 1);
+  test_reject("header only", 7, sizeof(rhmapper_snapshot_t),
+              sizeof(rhmapper_snapshot_t));
+  test_reject("short header", 7, length, sizeof(rhmapper_snapshot_t) - 1);
+  test_reject("empty", 7, length, 0);
+#ifdef RHMAPPER_REVERSE
+  test_reject("size below reverse", 3, header->size - 1, length);
+#endif
+  if (rhmapper_open_mmap("test_snapshot_missing.rhm") != NULL) {
+    test_fail("missing", 0, 1);
+  }
+
+  free(test_file);
+  remove(TEST_PATH);
+  remove(TEST_BAD_PATH);
+  printf("ok, %d keys round-tripped\n", TEST_KEYS);
+  return 0;
+}